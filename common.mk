@@ -19,3 +19,30 @@ LDFLAGS = -Wl,--gc-sections
 PG_ROOT = $(shell cd "$(dir $(lastword $(MAKEFILE_LIST)))/vendor/pg18" && pwd)
 PG_INCLUDE = $(PG_ROOT)/src/include
 PG_BACKEND_LIBS = $(PG_ROOT)/src/backend/backend-libs.txt
+
+# Replace the C library's malloc with mimalloc, linked into libpostgres.a.
+# Needs the mimalloc sources in MIMALLOC_DIR (make WITH_MIMALLOC=1)
+WITH_MIMALLOC ?= 0
+MIMALLOC_DIR ?= $(shell cd "$(dir $(lastword $(MAKEFILE_LIST)))" && pwd)/vendor/mimalloc
+
+# Keep "shared" memory and semaphores private to the process, see
+# src/embedded_shmem.c (make PRIVATE_SHMEM=1)
+PRIVATE_SHMEM ?= 0
+
+# Build PostgreSQL with io_uring (io_method = io_uring), statically linked
+# against liburing from LIBURING_DIR (make WITH_LIBURING=1; needs make clean)
+WITH_LIBURING ?= 0
+LIBURING_DIR ?= $(shell cd "$(dir $(lastword $(MAKEFILE_LIST)))" && pwd)/vendor/liburing
+
+# Build PostgreSQL with lz4 and/or zstd for wal_compression and TOAST,
+# statically linked from LZ4_DIR / ZSTD_DIR (make WITH_LZ4=1 WITH_ZSTD=1;
+# needs make clean)
+WITH_LZ4 ?= 0
+WITH_ZSTD ?= 0
+LZ4_DIR ?= $(shell cd "$(dir $(lastword $(MAKEFILE_LIST)))" && pwd)/vendor/lz4
+ZSTD_DIR ?= $(shell cd "$(dir $(lastword $(MAKEFILE_LIST)))" && pwd)/vendor/zstd
+
+# Page and WAL block sizes in kB PostgreSQL is configured with; clusters
+# only open with the sizes they were created with (needs make clean)
+BLOCKSIZE ?= 8
+WAL_BLOCKSIZE ?= 8
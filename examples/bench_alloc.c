@@ -0,0 +1,138 @@
+/*
+ * bench_alloc.c - Benchmark allocation-heavy workloads
+ *
+ * Times queries whose cost is dominated by many small allocations: large
+ * result copies, notification capture, and extension types (pgvector,
+ * PL/pgSQL).  Build the examples once with the default allocator and once
+ * with "make WITH_MIMALLOC=1" and compare the numbers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pgembedded.h"
+
+extern void register_plpgsql(void);
+extern void register_vector(void);
+
+static double
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int
+run(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0;
+
+	if (!ok)
+		fprintf(stderr, "ERROR: %s\n  in: %s\n", pg_embedded_error_message(), sql);
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+/* Run a query "iterations" times and print the mean time per run */
+static int
+bench(const char *name, const char *sql, int iterations)
+{
+	double		start = now_ms();
+	int			i;
+
+	for (i = 0; i < iterations; i++)
+	{
+		if (!run(sql))
+			return 0;
+	}
+
+	printf("  %-28s %10.2f ms/run\n", name, (now_ms() - start) / iterations);
+	return 1;
+}
+
+static int
+bench_notifications(int count)
+{
+	double		start = now_ms();
+	char		sql[128];
+	int			i;
+
+	if (pg_embedded_listen("bench") != 0)
+		return 0;
+
+	for (i = 0; i < count; i++)
+	{
+		pg_notification *n;
+
+		snprintf(sql, sizeof(sql), "NOTIFY bench, 'payload %d'", i);
+		if (!run(sql))
+			return 0;
+		while ((n = pg_embedded_poll_notifications()) != NULL)
+			pg_embedded_free_notification(n);
+	}
+
+	printf("  %-28s %10.2f us/notify\n", "notify + poll",
+		   (now_ms() - start) * 1000.0 / count);
+	return pg_embedded_unlisten("bench") == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	int			ok = 1;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	register_plpgsql();
+	register_vector();
+
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	ok = ok && run("CREATE EXTENSION IF NOT EXISTS vector");
+	ok = ok && run("DROP TABLE IF EXISTS bench_vec");
+	ok = ok && run("CREATE TABLE bench_vec AS "
+				   "SELECT g AS id, array_fill(g % 97, ARRAY[64])::vector AS v "
+				   "FROM generate_series(1, 20000) g");
+	ok = ok && run("CREATE OR REPLACE FUNCTION bench_loop(n int) RETURNS text AS $$ "
+				   "DECLARE s text := ''; BEGIN "
+				   "FOR i IN 1..n LOOP s := left(s || i::text, 64); END LOOP; "
+				   "RETURN s; END $$ LANGUAGE plpgsql");
+
+	printf("Result-heavy:\n");
+	ok = ok && bench("100k rows x 3 text cols",
+					 "SELECT g, md5(g::text), repeat('x', 20) "
+					 "FROM generate_series(1, 100000) g", 10);
+	ok = ok && bench("1k rows x 3 text cols",
+					 "SELECT g, md5(g::text), repeat('x', 20) "
+					 "FROM generate_series(1, 1000) g", 1000);
+	ok = ok && bench_notifications(10000);
+
+	printf("Extension-heavy:\n");
+	ok = ok && bench("pgvector distance scan",
+					 "SELECT id FROM bench_vec "
+					 "ORDER BY v <-> array_fill(42, ARRAY[64])::vector LIMIT 10", 20);
+	ok = ok && bench("pgvector text output",
+					 "SELECT v FROM bench_vec LIMIT 5000", 10);
+	ok = ok && bench("plpgsql string loop",
+					 "SELECT bench_loop(100000)", 10);
+
+	run("DROP TABLE IF EXISTS bench_vec");
+	run("DROP FUNCTION IF EXISTS bench_loop(int)");
+	pg_embedded_shutdown();
+
+	return ok ? 0 : 1;
+}
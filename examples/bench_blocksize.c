@@ -0,0 +1,119 @@
+/*
+ * bench_blocksize.c - Compare scan and point-lookup throughput per page size
+ *
+ * Usage: bench_blocksize <data_directory>
+ *
+ * Meant to be run once per build variant ("make variants" at the top
+ * level, then "make bench-variants"), each against its own cluster image:
+ * a cluster only works with the block sizes it was created with.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pgembedded.h"
+
+#define ROWS		1000000
+#define LOOKUPS		200000
+#define RUNS		5
+
+static double
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Run a query, print its first value if "label" is set */
+static int
+run(const char *sql, const char *label)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0;
+
+	if (!ok)
+		fprintf(stderr, "ERROR: %s\n  in: %s\n", pg_embedded_error_message(), sql);
+	else if (label && result->rows > 0 && result->values)
+		printf("  %-24s %s\n", label, result->values[0][0]);
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+/* Best time of RUNS runs, after one run to warm the cache */
+static double
+bench(const char *sql)
+{
+	double		best = 0;
+	int			i;
+
+	if (!run(sql, NULL))
+		return -1;
+
+	for (i = 0; i < RUNS; i++)
+	{
+		double		t = now_ms();
+
+		if (!run(sql, NULL))
+			return -1;
+		t = now_ms() - t;
+		if (i == 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+int
+main(int argc, char **argv)
+{
+	char		sql[512];
+	double		scan_ms;
+	double		lookup_ms;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	run("SHOW block_size", "block_size");
+	run("SHOW wal_block_size", "wal_block_size");
+
+	snprintf(sql, sizeof(sql),
+			 "CREATE TABLE IF NOT EXISTS bench_bs AS "
+			 "SELECT g AS id, g %% 1000 AS v, md5(g::text) AS pad "
+			 "FROM generate_series(1, %d) g", ROWS);
+	if (!run(sql, NULL) ||
+		!run("CREATE UNIQUE INDEX IF NOT EXISTS bench_bs_id ON bench_bs (id)", NULL) ||
+		!run("VACUUM ANALYZE bench_bs", NULL))
+		return 1;
+
+	run("SELECT pg_size_pretty(pg_relation_size('bench_bs'))", "table size");
+	run("SELECT pg_size_pretty(pg_relation_size('bench_bs_id'))", "index size");
+
+	scan_ms = bench("SELECT count(*) FROM bench_bs WHERE v = 7");
+
+	/* Index lookups of scattered keys, all in one statement */
+	snprintf(sql, sizeof(sql),
+			 "SELECT sum((SELECT v FROM bench_bs WHERE id = (g * 7919) %% %d + 1)) "
+			 "FROM generate_series(1, %d) g", ROWS, LOOKUPS);
+	lookup_ms = bench(sql);
+
+	if (scan_ms < 0 || lookup_ms < 0)
+		return 1;
+
+	printf("  %-24s %10.0f rows/s\n", "sequential scan", ROWS / (scan_ms / 1000.0));
+	printf("  %-24s %10.0f lookups/s\n", "point lookup", LOOKUPS / (lookup_ms / 1000.0));
+
+	pg_embedded_shutdown();
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * bench_partitions.c - Benchmark queries over many partitions per lock setting
+ *
+ * Usage: bench_partitions <data_directory> [partitions]
+ *
+ * Builds a hash-partitioned table (256 partitions by default, each with
+ * an index), then times a query that cannot prune and so locks every
+ * partition and index, once with the memory profile's
+ * max_locks_per_transaction and once raised above the number of
+ * relations the query locks.  For each it prints the fast-path lock
+ * slots, the relation locks that spilled into the shared lock table and
+ * the size of shared memory, which under memory_budget includes the
+ * bigger lock table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pgembedded.h"
+
+#define QUERIES 1000
+
+static double
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int
+run(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0;
+
+	if (!ok)
+		fprintf(stderr, "ERROR: %s\n  in: %s\n", pg_embedded_error_message(), sql);
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+static int
+start(const char *datadir, const pg_embedded_config *config)
+{
+	pg_embedded_set_config(config);
+	if (pg_embedded_init(datadir, "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 0;
+	}
+	return 1;
+}
+
+/* Relation locks the query holds outside the fast path, -1 on error */
+static long
+spilled_locks(const char *sql)
+{
+	pg_result  *result;
+	long		spilled = -1;
+
+	if (pg_embedded_begin() != 0)
+		return -1;
+	if (run(sql))
+	{
+		result = pg_embedded_exec("SELECT count(*) FROM pg_locks "
+								  "WHERE locktype = 'relation' AND NOT fastpath "
+								  "AND pid = pg_backend_pid()");
+		if (result && result->status >= 0 && result->rows == 1 &&
+			result->values[0][0])
+			spilled = atol(result->values[0][0]);
+		pg_embedded_free_result(result);
+	}
+	pg_embedded_rollback();
+	return spilled;
+}
+
+static int
+bench(const char *datadir, pg_embedded_config *config, const char *sql)
+{
+	pg_memory_footprint footprint;
+	long		spilled;
+	double		t;
+	int			i;
+
+	if (!start(datadir, config))
+		return 0;
+	if (pg_embedded_memory_footprint(&footprint) != 0)
+	{
+		fprintf(stderr, "ERROR: %s\n", pg_embedded_error_message());
+		pg_embedded_shutdown();
+		return 0;
+	}
+	spilled = spilled_locks(sql);
+
+	/* Once to warm the caches */
+	if (!run(sql))
+		return 0;
+	t = now_ms();
+	for (i = 0; i < QUERIES; i++)
+		if (!run(sql))
+			return 0;
+	t = now_ms() - t;
+
+	printf("  %8d %10d %12ld %10zu kB %10.3f ms\n",
+		   footprint.max_locks_per_transaction, footprint.fast_path_lock_slots,
+		   spilled, footprint.shared_memory_bytes / 1024, t / QUERIES);
+	pg_embedded_shutdown();
+	return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+	pg_embedded_config config = {
+		.fsync = true,
+		.synchronous_commit = true,
+		.full_page_writes = true,
+		.memory_budget = 64 * 1024 * 1024,
+	};
+	const char *sql = "SELECT count(*) FROM bench_parts WHERE k = 42";
+	const char *datadir;
+	int			partitions = 256;
+	int			locks;
+	int			i;
+	char		buf[256];
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory> [partitions]\n", argv[0]);
+		return 1;
+	}
+	datadir = argv[1];
+	if (argc > 2)
+		partitions = atoi(argv[2]);
+	if (partitions < 1 || partitions > 8192)
+	{
+		fprintf(stderr, "ERROR: partitions must be between 1 and 8192\n");
+		return 1;
+	}
+
+	if (!start(datadir, &config))
+		return 1;
+	if (!run("DROP TABLE IF EXISTS bench_parts") ||
+		!run("CREATE TABLE bench_parts (id int, k int) PARTITION BY HASH (id)"))
+		return 1;
+	for (i = 0; i < partitions; i++)
+	{
+		snprintf(buf, sizeof(buf),
+				 "CREATE TABLE bench_parts_%d PARTITION OF bench_parts "
+				 "FOR VALUES WITH (MODULUS %d, REMAINDER %d)",
+				 i, partitions, i);
+		if (!run(buf))
+			return 1;
+	}
+	if (!run("CREATE INDEX ON bench_parts (k)") ||
+		!run("INSERT INTO bench_parts SELECT g, g % 1000 "
+			 "FROM generate_series(1, 100000) g") ||
+		!run("VACUUM ANALYZE bench_parts"))
+		return 1;
+	pg_embedded_shutdown();
+
+	/* Each partition and its index, plus the parent and its index */
+	locks = 2 * partitions + 2;
+
+	printf("%d partitions, %d relation locks per query:\n", partitions, locks);
+	printf("  %8s %10s %12s %13s %13s\n",
+		   "max_locks", "fast-path", "spilled", "shared mem", "per query");
+	if (!bench(datadir, &config, sql))
+		return 1;
+	config.max_locks_per_transaction = locks + 16;
+	if (!bench(datadir, &config, sql))
+		return 1;
+
+	if (!start(datadir, &config))
+		return 1;
+	run("DROP TABLE bench_parts");
+	pg_embedded_shutdown();
+	return 0;
+}
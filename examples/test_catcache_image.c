@@ -0,0 +1,269 @@
+/*
+ * test_catcache_image - Test the catalog cache image
+ *
+ * Usage: test_catcache_image <data_directory>
+ *
+ * Runs queries over a few dozen tables with pg_embedded_config.catcache_image
+ * set, shuts down, and checks that the image was written and that the next
+ * start comes up with warm caches (measured as the size of
+ * CacheMemoryContext and everything below it).  It then starts again from
+ * copies of the image that were corrupted, truncated or given a bad header,
+ * and checks that pg_embedded_init still succeeds and queries still work,
+ * with the caches as cold as without an image when nothing in it is usable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pgembedded.h"
+
+#define TABLES 40
+
+static int	failures = 0;
+
+static int
+exec_or_die(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+
+	if (!result || result->status < 0)
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+		pg_embedded_free_result(result);
+		return -1;
+	}
+	pg_embedded_free_result(result);
+	return 0;
+}
+
+static void
+check(const char *what, int ok)
+{
+	printf("  %-52s %s\n", what, ok ? "OK" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+static int
+init(const char *datadir)
+{
+	pg_embedded_config config = {
+		.fsync = true,
+		.synchronous_commit = true,
+		.full_page_writes = true,
+		.catcache_image = true,
+	};
+
+	pg_embedded_set_config(&config);
+	if (pg_embedded_init(datadir, "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return -1;
+	}
+	return 0;
+}
+
+/* Bytes held by CacheMemoryContext and its children, 0 on error */
+static size_t
+cache_bytes(void)
+{
+	pg_memory_stats stats;
+	size_t		total = 0;
+	char	   *in_cache;
+	int			i;
+
+	if (pg_embedded_memory_stats(&stats) != 0)
+		return 0;
+	in_cache = calloc(stats.ncontexts > 0 ? stats.ncontexts : 1, 1);
+	for (i = 0; in_cache && i < stats.ncontexts; i++)
+	{
+		const pg_memory_context_stats *cxt = &stats.contexts[i];
+
+		/* Parents come before their children */
+		in_cache[i] = strcmp(cxt->name, "CacheMemoryContext") == 0 ||
+			(cxt->parent >= 0 && in_cache[cxt->parent]);
+		if (in_cache[i])
+			total += cxt->total_bytes;
+	}
+	free(in_cache);
+	pg_embedded_free_memory_stats(&stats);
+	return total;
+}
+
+/* Touch every table, as the workload whose caches should come back */
+static int
+run_workload(void)
+{
+	char		sql[128];
+	int			i;
+
+	for (i = 0; i < TABLES; i++)
+	{
+		snprintf(sql, sizeof(sql),
+				 "SELECT count(*) FROM ci_t%d WHERE k = 1", i);
+		if (exec_or_die(sql) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+static char *
+read_file(const char *path, long *size)
+{
+	FILE	   *file = fopen(path, "rb");
+	char	   *data = NULL;
+
+	*size = -1;
+	if (!file)
+		return NULL;
+	if (fseek(file, 0, SEEK_END) == 0 && (*size = ftell(file)) > 0 &&
+		fseek(file, 0, SEEK_SET) == 0)
+	{
+		data = malloc(*size);
+		if (data && fread(data, 1, *size, file) != (size_t) *size)
+		{
+			free(data);
+			data = NULL;
+		}
+	}
+	fclose(file);
+	return data;
+}
+
+static int
+write_file(const char *path, const char *data, long size)
+{
+	FILE	   *file = fopen(path, "wb");
+	int			ok;
+
+	if (!file)
+		return -1;
+	ok = fwrite(data, 1, size, file) == (size_t) size;
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+/*
+ * Start with the given image in place (or none), check that a query works,
+ * and return the size of the caches right after init, 0 on failure.
+ */
+static size_t
+start_with(const char *datadir, const char *path, const char *data, long size)
+{
+	size_t		bytes;
+
+	if (data == NULL)
+		unlink(path);
+	else if (write_file(path, data, size) != 0)
+		return 0;
+	if (init(datadir) != 0)
+		return 0;
+	bytes = cache_bytes();
+	if (run_workload() != 0)
+		bytes = 0;
+	pg_embedded_shutdown();
+	return bytes;
+}
+
+int
+main(int argc, char **argv)
+{
+	char		path[4096];
+	char		sql[128];
+	char	   *image;
+	char	   *damaged;
+	long		size;
+	size_t		warm;
+	size_t		cold;
+	size_t		bytes;
+	long		i;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/pg_embedded_catcache", argv[1]);
+
+	printf("Saving the image:\n");
+	if (init(argv[1]) != 0)
+		return 1;
+	for (i = 0; i < TABLES; i++)
+	{
+		snprintf(sql, sizeof(sql), "DROP TABLE IF EXISTS ci_t%ld", i);
+		if (exec_or_die(sql) != 0)
+			return 1;
+		snprintf(sql, sizeof(sql),
+				 "CREATE TABLE ci_t%ld (id int PRIMARY KEY, k int, v text)", i);
+		if (exec_or_die(sql) != 0)
+			return 1;
+		snprintf(sql, sizeof(sql), "CREATE INDEX ON ci_t%ld (k)", i);
+		if (exec_or_die(sql) != 0)
+			return 1;
+	}
+	if (run_workload() != 0)
+		return 1;
+	pg_embedded_shutdown();
+
+	image = read_file(path, &size);
+	check("shutdown writes the image", image != NULL && size > 64);
+	if (!image)
+	{
+		printf("FAILED\n");
+		return 1;
+	}
+
+	printf("Restarting:\n");
+	cold = start_with(argv[1], path, NULL, 0);
+	check("init without an image succeeds", cold > 0);
+	warm = start_with(argv[1], path, image, size);
+	check("init with the image succeeds", warm > 0);
+	check("the image warms the caches", warm > cold);
+
+	printf("Damaged images:\n");
+	damaged = malloc(size);
+	if (!damaged)
+		return 1;
+
+	/* Garbage past the header and the first relation OIDs */
+	memcpy(damaged, image, size);
+	for (i = 48; i < size; i++)
+		damaged[i] = (char) (i * 131 + 7);
+	check("init with a corrupted image succeeds",
+		  start_with(argv[1], path, damaged, size) > 0);
+
+	check("init with half an image succeeds",
+		  start_with(argv[1], path, image, size / 2) > 0);
+
+	bytes = start_with(argv[1], path, image, 10);
+	check("init with a truncated header succeeds, caches cold",
+		  bytes > 0 && bytes < warm);
+
+	memcpy(damaged, image, size);
+	damaged[0] ^= 0xff;
+	bytes = start_with(argv[1], path, damaged, size);
+	check("init with a bad magic number succeeds, caches cold",
+		  bytes > 0 && bytes < warm);
+
+	free(damaged);
+	damaged = read_file(path, &size);
+	check("the damaged image is replaced at shutdown",
+		  damaged != NULL && size > 64 && damaged[0] == image[0]);
+	free(damaged);
+	free(image);
+
+	if (init(argv[1]) == 0)
+	{
+		for (i = 0; i < TABLES; i++)
+		{
+			snprintf(sql, sizeof(sql), "DROP TABLE ci_t%ld", i);
+			exec_or_die(sql);
+		}
+		pg_embedded_shutdown();
+	}
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * test_host_trigger - Test host trigger callbacks
+ *
+ * Usage: test_host_trigger <data_directory>
+ *
+ * Attaches a host callback to a table as row triggers and to another one
+ * as statement triggers with transition tables, runs INSERT, UPDATE and
+ * DELETE against both, and checks the number of calls and the OLD and NEW
+ * values each call received.  It also checks that a BEFORE trigger whose
+ * callback fails aborts the statement.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+
+#define INT4OID 23
+
+static int	failures = 0;
+
+/* What the callback saw since the last reset */
+typedef struct seen
+{
+	int			calls;
+	bool		per_statement;
+	pg_trigger_op op;
+	uint64_t	rows;
+	int			old_rows;		/* Rows with an OLD side */
+	int			new_rows;		/* Rows with a NEW side */
+	int64_t		old_qty;		/* Sum of OLD qty */
+	int64_t		new_qty;		/* Sum of NEW qty */
+	int			null_qty;		/* NEW rows with a NULL qty */
+	bool		paired;			/* UPDATE: OLD and NEW rows have the same id */
+	bool		types;			/* Both columns reported as int4 */
+} seen;
+
+static seen last;
+
+static void
+reset(void)
+{
+	memset(&last, 0, sizeof(last));
+	last.paired = true;
+	last.types = true;
+}
+
+static int
+record_cb(const pg_trigger_event *event, void *arg)
+{
+	uint64_t	r;
+
+	(void) arg;
+	last.calls++;
+	last.per_statement = event->per_statement;
+	last.op = event->op;
+	last.rows += event->nrows;
+	if (event->natts != 2 || event->atttypes[0] != INT4OID ||
+		event->atttypes[1] != INT4OID)
+		last.types = false;
+
+	for (r = 0; r < event->nrows && event->natts == 2; r++)
+	{
+		if (event->old_values)
+		{
+			last.old_rows++;
+			if (!event->old_isnull[r * 2 + 1])
+				last.old_qty += (int32_t) event->old_values[r * 2 + 1];
+		}
+		if (event->new_values)
+		{
+			last.new_rows++;
+			if (event->new_isnull[r * 2 + 1])
+				last.null_qty++;
+			else
+				last.new_qty += (int32_t) event->new_values[r * 2 + 1];
+		}
+		if (event->old_values && event->new_values &&
+			(int32_t) event->old_values[r * 2] != (int32_t) event->new_values[r * 2])
+			last.paired = false;
+	}
+	return 0;
+}
+
+/* Fails for rows with a negative id */
+static int
+reject_cb(const pg_trigger_event *event, void *arg)
+{
+	(void) arg;
+	if (event->new_values && (int32_t) event->new_values[0] < 0)
+		return 1;
+	return 0;
+}
+
+static int
+exec_or_die(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+
+	if (!result || result->status < 0)
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+		pg_embedded_free_result(result);
+		return -1;
+	}
+	pg_embedded_free_result(result);
+	return 0;
+}
+
+static int
+exec_ok(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0;
+
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+static void
+check(const char *what, int ok)
+{
+	printf("  %-52s %s\n", what, ok ? "OK" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/* First value of a one-row query, compared with "expected" */
+static int
+query_is(const char *sql, const char *expected)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0 && result->rows == 1 &&
+		result->values[0][0] && strcmp(result->values[0][0], expected) == 0;
+
+	if (!result || result->status < 0)
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+	pg_embedded_config config = {
+		.fsync = true,
+		.synchronous_commit = true,
+		.full_page_writes = true,
+	};
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	/* Registrations may come before init */
+	if (pg_embedded_register_trigger("record", record_cb, NULL) != 0 ||
+		pg_embedded_register_trigger("reject", reject_cb, NULL) != 0)
+	{
+		fprintf(stderr, "ERROR: %s\n", pg_embedded_error_message());
+		return 1;
+	}
+
+	pg_embedded_set_config(&config);
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	if (exec_or_die("DROP TABLE IF EXISTS ht_rows, ht_batch") != 0 ||
+		exec_or_die("CREATE OR REPLACE FUNCTION pg_embedded_host_trigger() "
+					"RETURNS trigger LANGUAGE C "
+					"AS 'pg_embedded_triggers', 'pg_embedded_host_trigger'") != 0 ||
+		exec_or_die("CREATE TABLE ht_rows (id int PRIMARY KEY, qty int)") != 0 ||
+		exec_or_die("CREATE TABLE ht_batch (id int PRIMARY KEY, qty int)") != 0 ||
+		exec_or_die("CREATE TRIGGER ht_rows_record "
+					"AFTER INSERT OR UPDATE OR DELETE ON ht_rows FOR EACH ROW "
+					"EXECUTE FUNCTION pg_embedded_host_trigger('record')") != 0 ||
+		exec_or_die("CREATE TRIGGER ht_batch_ins AFTER INSERT ON ht_batch "
+					"REFERENCING NEW TABLE AS n FOR EACH STATEMENT "
+					"EXECUTE FUNCTION pg_embedded_host_trigger('record')") != 0 ||
+		exec_or_die("CREATE TRIGGER ht_batch_upd AFTER UPDATE ON ht_batch "
+					"REFERENCING OLD TABLE AS o NEW TABLE AS n FOR EACH STATEMENT "
+					"EXECUTE FUNCTION pg_embedded_host_trigger('record')") != 0 ||
+		exec_or_die("CREATE TRIGGER ht_batch_del AFTER DELETE ON ht_batch "
+					"REFERENCING OLD TABLE AS o FOR EACH STATEMENT "
+					"EXECUTE FUNCTION pg_embedded_host_trigger('record')") != 0)
+	{
+		pg_embedded_shutdown();
+		return 1;
+	}
+
+	printf("Row triggers:\n");
+	reset();
+	exec_or_die("INSERT INTO ht_rows VALUES (1, 10), (2, 20), (3, 30)");
+	check("INSERT of 3 rows makes 3 calls",
+		  last.calls == 3 && last.rows == 3 && !last.per_statement &&
+		  last.op == PG_TRIGGER_INSERT && last.types);
+	check("INSERT passes NEW rows only, qty 10+20+30",
+		  last.new_rows == 3 && last.old_rows == 0 && last.new_qty == 60);
+
+	reset();
+	exec_or_die("UPDATE ht_rows SET qty = qty + 1 WHERE id <= 2");
+	check("UPDATE of 2 rows makes 2 calls",
+		  last.calls == 2 && last.op == PG_TRIGGER_UPDATE);
+	check("UPDATE passes OLD qty 10+20 and NEW qty 11+21",
+		  last.old_rows == 2 && last.new_rows == 2 &&
+		  last.old_qty == 30 && last.new_qty == 32 && last.paired);
+
+	reset();
+	exec_or_die("DELETE FROM ht_rows WHERE id = 3");
+	check("DELETE passes the OLD row only, qty 30",
+		  last.calls == 1 && last.op == PG_TRIGGER_DELETE &&
+		  last.old_rows == 1 && last.new_rows == 0 && last.old_qty == 30);
+
+	reset();
+	exec_or_die("INSERT INTO ht_rows VALUES (4, NULL)");
+	check("a NULL qty is passed as NULL",
+		  last.calls == 1 && last.null_qty == 1 && last.new_qty == 0);
+
+	printf("Statement triggers with transition tables:\n");
+	reset();
+	exec_or_die("INSERT INTO ht_batch SELECT g, g FROM generate_series(1, 100) g");
+	check("INSERT of 100 rows makes 1 call with 100 rows",
+		  last.calls == 1 && last.rows == 100 && last.per_statement &&
+		  last.op == PG_TRIGGER_INSERT && last.types);
+	check("INSERT passes NEW qty summing to 5050",
+		  last.new_rows == 100 && last.old_rows == 0 && last.new_qty == 5050);
+
+	reset();
+	exec_or_die("UPDATE ht_batch SET qty = qty * 2 WHERE id <= 10");
+	check("UPDATE of 10 rows makes 1 call with 10 rows",
+		  last.calls == 1 && last.rows == 10 && last.op == PG_TRIGGER_UPDATE);
+	check("UPDATE passes OLD qty 55 and NEW qty 110, paired",
+		  last.old_rows == 10 && last.new_rows == 10 &&
+		  last.old_qty == 55 && last.new_qty == 110 && last.paired);
+
+	reset();
+	exec_or_die("DELETE FROM ht_batch WHERE id > 50");
+	check("DELETE of 50 rows passes OLD qty summing to 3775",
+		  last.calls == 1 && last.rows == 50 && last.op == PG_TRIGGER_DELETE &&
+		  last.old_rows == 50 && last.new_rows == 0 && last.old_qty == 3775);
+
+	reset();
+	exec_or_die("UPDATE ht_batch SET qty = 0 WHERE id < 0");
+	check("UPDATE of no rows still makes 1 call, with 0 rows",
+		  last.calls == 1 && last.rows == 0);
+
+	printf("Failing callback:\n");
+	if (exec_or_die("CREATE TRIGGER ht_rows_reject BEFORE INSERT ON ht_rows "
+					"FOR EACH ROW EXECUTE FUNCTION pg_embedded_host_trigger('reject')") != 0)
+	{
+		pg_embedded_shutdown();
+		return 1;
+	}
+	check("INSERT with a rejected row fails",
+		  !exec_ok("INSERT INTO ht_rows VALUES (5, 50), (-1, 0)"));
+	check("no row of that INSERT is kept",
+		  query_is("SELECT count(*) FROM ht_rows WHERE id IN (5, -1)", "0"));
+	check("BEFORE trigger keeps accepted rows",
+		  exec_ok("INSERT INTO ht_rows VALUES (6, 60)") &&
+		  query_is("SELECT qty FROM ht_rows WHERE id = 6", "60"));
+
+	exec_or_die("DROP TABLE ht_rows, ht_batch");
+	pg_embedded_shutdown();
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
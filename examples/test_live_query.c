@@ -0,0 +1,244 @@
+/*
+ * test_live_query - Test live queries and the relation change counters
+ *
+ * Usage: test_live_query <data_directory>
+ *
+ * Subscribes to a query on a table and to one on a materialized view of
+ * it, then changes the table in different ways and checks what
+ * pg_embedded_live_refresh() delivers: nothing while the change is
+ * uncommitted or after it was rolled back, and after a commit, a COPY
+ * FROM, a TRUNCATE or a REFRESH MATERIALIZED VIEW exactly the rows that
+ * appeared and disappeared.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+
+static int	failures = 0;
+
+/* The last delivery to one subscription, rows as sorted "id|v" lists */
+typedef struct delivery
+{
+	int			count;
+	char		added[512];
+	char		removed[512];
+} delivery;
+
+static int
+compare_strings(const void *a, const void *b)
+{
+	return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+static void
+rows_text(const pg_result *result, char *buf, size_t len)
+{
+	char		rows[32][64];
+	const char *sorted[32];
+	int			n = 0;
+	int			i;
+
+	buf[0] = '\0';
+	if (!result)
+		return;
+	for (n = 0; (uint64_t) n < result->rows && n < 32; n++)
+	{
+		snprintf(rows[n], sizeof(rows[n]), "%s|%s",
+				 result->values[n][0] ? result->values[n][0] : "NULL",
+				 result->values[n][1] ? result->values[n][1] : "NULL");
+		sorted[n] = rows[n];
+	}
+	qsort(sorted, n, sizeof(char *), compare_strings);
+	for (i = 0; i < n; i++)
+	{
+		if (i > 0)
+			strncat(buf, ",", len - strlen(buf) - 1);
+		strncat(buf, sorted[i], len - strlen(buf) - 1);
+	}
+}
+
+static void
+live_cb(int id, const pg_result *added, const pg_result *removed, void *arg)
+{
+	delivery   *d = arg;
+
+	(void) id;
+	d->count++;
+	rows_text(added, d->added, sizeof(d->added));
+	rows_text(removed, d->removed, sizeof(d->removed));
+}
+
+static int
+exec_or_die(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+
+	if (!result || result->status < 0)
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+		pg_embedded_free_result(result);
+		return -1;
+	}
+	pg_embedded_free_result(result);
+	return 0;
+}
+
+static void
+check(const char *what, int ok)
+{
+	printf("  %-52s %s\n", what, ok ? "OK" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/* Was the last delivery, if any since "before", exactly this diff? */
+static int
+delivered(const delivery *d, int before, const char *added, const char *removed)
+{
+	if (d->count != before + 1)
+		return 0;
+	return strcmp(d->added, added) == 0 && strcmp(d->removed, removed) == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	pg_embedded_config config = {
+		.fsync = true,
+		.synchronous_commit = true,
+		.full_page_writes = true,
+	};
+	delivery	items = {0};
+	delivery	view = {0};
+	char		datadir[PATH_MAX];
+	char		path[PATH_MAX + 32];
+	char		sql[PATH_MAX + 64];
+	FILE	   *copy;
+	int			items_id;
+	int			view_id;
+	int			n;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	pg_embedded_set_config(&config);
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	if (exec_or_die("DROP MATERIALIZED VIEW IF EXISTS lq_view") != 0 ||
+		exec_or_die("DROP TABLE IF EXISTS lq_items") != 0 ||
+		exec_or_die("CREATE TABLE lq_items (id int, v text)") != 0 ||
+		exec_or_die("INSERT INTO lq_items VALUES (1, 'a'), (2, 'b')") != 0 ||
+		exec_or_die("CREATE MATERIALIZED VIEW lq_view AS "
+					"SELECT id, v FROM lq_items") != 0)
+	{
+		pg_embedded_shutdown();
+		return 1;
+	}
+
+	printf("Subscribing:\n");
+	items_id = pg_embedded_live_query("SELECT id, v FROM lq_items", live_cb, &items);
+	view_id = pg_embedded_live_query("SELECT id, v FROM lq_view", live_cb, &view);
+	check("both subscriptions are made", items_id >= 0 && view_id >= 0);
+	check("the first delivery has the whole result",
+		  delivered(&items, 0, "1|a,2|b", "") && delivered(&view, 0, "1|a,2|b", ""));
+	check("refresh without changes re-runs nothing",
+		  pg_embedded_live_refresh() == 0 && items.count == 1 && view.count == 1);
+
+	printf("Transactions:\n");
+	n = items.count;
+	if (pg_embedded_begin() != 0 ||
+		exec_or_die("INSERT INTO lq_items VALUES (3, 'c')") != 0)
+		failures++;
+	check("refresh inside the transaction is refused",
+		  pg_embedded_live_refresh() == -1 && items.count == n);
+	pg_embedded_rollback();
+	check("nothing is delivered after a rollback",
+		  pg_embedded_live_refresh() == 0 && items.count == n);
+
+	if (pg_embedded_begin() != 0 ||
+		exec_or_die("INSERT INTO lq_items VALUES (3, 'c')") != 0 ||
+		pg_embedded_commit() != 0)
+		failures++;
+	check("after the commit only the table's query re-runs",
+		  pg_embedded_live_refresh() == 1 && view.count == 1);
+	check("it delivers the inserted row",
+		  delivered(&items, n, "3|c", ""));
+
+	n = items.count;
+	exec_or_die("UPDATE lq_items SET v = 'z' WHERE id = 1");
+	pg_embedded_live_refresh();
+	check("an UPDATE delivers the new row and removes the old",
+		  delivered(&items, n, "1|z", "1|a"));
+
+	n = items.count;
+	exec_or_die("DELETE FROM lq_items WHERE id = 1 AND v = 'nothing'");
+	check("a DELETE of no rows delivers nothing",
+		  pg_embedded_live_refresh() <= 1 && items.count == n);
+
+	printf("Utility commands:\n");
+	n = view.count;
+	exec_or_die("REFRESH MATERIALIZED VIEW lq_view");
+	pg_embedded_live_refresh();
+	check("REFRESH MATERIALIZED VIEW re-evaluates the view's query",
+		  delivered(&view, n, "1|z,3|c", "1|a"));
+
+	/* Server-side COPY wants an absolute path */
+	if (!realpath(argv[1], datadir))
+	{
+		perror(argv[1]);
+		failures++;
+	}
+	else
+	{
+		snprintf(path, sizeof(path), "%s/lq_copy.txt", datadir);
+		copy = fopen(path, "w");
+		if (copy)
+		{
+			fprintf(copy, "4\td\n5\te\n");
+			fclose(copy);
+		}
+		n = items.count;
+		snprintf(sql, sizeof(sql), "COPY lq_items FROM '%s'", path);
+		exec_or_die(sql);
+		remove(path);
+		pg_embedded_live_refresh();
+		check("COPY FROM re-evaluates and delivers the copied rows",
+			  delivered(&items, n, "4|d,5|e", ""));
+	}
+
+	n = items.count;
+	exec_or_die("TRUNCATE lq_items");
+	pg_embedded_live_refresh();
+	check("TRUNCATE re-evaluates and removes every row",
+		  delivered(&items, n, "", "1|z,2|b,3|c,4|d,5|e"));
+	check("the view still has its rows",
+		  view.count == 2 && strcmp(view.added, "1|z,3|c") == 0);
+
+	printf("Cancelling:\n");
+	check("both subscriptions are cancelled",
+		  pg_embedded_live_query_cancel(items_id) == 0 &&
+		  pg_embedded_live_query_cancel(view_id) == 0);
+	n = items.count;
+	exec_or_die("INSERT INTO lq_items VALUES (6, 'f')");
+	check("nothing is delivered after cancelling",
+		  pg_embedded_live_refresh() == 0 && items.count == n);
+
+	exec_or_die("DROP MATERIALIZED VIEW lq_view");
+	exec_or_die("DROP TABLE lq_items");
+	pg_embedded_shutdown();
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
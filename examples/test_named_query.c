@@ -0,0 +1,164 @@
+/*
+ * test_named_query - Test precompiled named queries across schema changes
+ *
+ * Usage: test_named_query <data_directory>
+ *
+ * Runs the queries helpers/querygen compiled from test_named_query_queries.sql
+ * into test_named_query.h, then changes the table they use (a column type,
+ * a dropped column, a drop and recreate with another column order) and
+ * checks that every run still returns the right rows.  Against a data
+ * directory set up like querygen's scratch cluster, the first runs use the
+ * embedded trees; otherwise they are analyzed from the SQL once, and the
+ * schema changes exercise the same replanning either way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+#include "test_named_query.h"
+
+static int	failures = 0;
+
+static int
+exec_or_die(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+
+	if (!result || result->status < 0)
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+		pg_embedded_free_result(result);
+		return -1;
+	}
+	pg_embedded_free_result(result);
+	return 0;
+}
+
+static void
+check(const char *what, int ok)
+{
+	printf("  %-52s %s\n", what, ok ? "OK" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/* Value of the named column in the only row, or NULL */
+static const char *
+column(const pg_result *result, const char *name)
+{
+	int			col;
+
+	if (!result || result->status < 0 || result->rows != 1)
+		return NULL;
+	for (col = 0; col < result->cols; col++)
+	{
+		if (strcmp(result->colnames[col], name) == 0)
+			return result->values[0][col];
+	}
+	return NULL;
+}
+
+static int
+add_item(const char *id, const char *name, const char *qty)
+{
+	const char *values[] = {id, name, qty};
+	pg_result  *result = pg_embedded_exec_named(QUERY_ADD_ITEM, 3, values);
+	int			ok = result && result->status >= 0 && result->rows == 1;
+
+	if (!ok)
+		fprintf(stderr, "ERROR: add_item: %s\n", pg_embedded_error_message());
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+/* Check the name, qty and column count item_by_id returns for id */
+static void
+check_item(const char *what, const char *id, const char *name,
+		   const char *qty, int cols)
+{
+	const char *values[] = {id};
+	pg_result  *result = pg_embedded_exec_named(QUERY_ITEM_BY_ID, 1, values);
+	const char *got_name = column(result, "name");
+	const char *got_qty = column(result, "qty");
+
+	if (!result || result->status < 0)
+		fprintf(stderr, "ERROR: item_by_id: %s\n", pg_embedded_error_message());
+	check(what,
+		  got_name && strcmp(got_name, name) == 0 &&
+		  got_qty && strcmp(got_qty, qty) == 0 &&
+		  result->cols == cols);
+	pg_embedded_free_result(result);
+}
+
+static void
+check_total(const char *what, const char *total)
+{
+	pg_result  *result = pg_embedded_exec_named(QUERY_TOTAL_QTY, 0, NULL);
+	const char *got = column(result, "sum");
+
+	check(what, got && strcmp(got, total) == 0);
+	pg_embedded_free_result(result);
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	/* Same table as test_named_query_schema.sql */
+	if (exec_or_die("DROP TABLE IF EXISTS nq_items") != 0 ||
+		exec_or_die("CREATE TABLE nq_items (id INTEGER PRIMARY KEY, "
+					"name TEXT NOT NULL, note TEXT, qty INTEGER NOT NULL)") != 0 ||
+		pg_embedded_register_named_queries(named_queries, NAMED_QUERY_COUNT) != 0)
+	{
+		pg_embedded_shutdown();
+		return 1;
+	}
+
+	printf("As compiled:\n");
+	check("insert two rows", add_item("1", "one", "10") && add_item("2", "two", "20"));
+	check_item("item 2", "2", "two", "20", 4);
+	check_total("total", "30");
+
+	printf("After ALTER COLUMN qty TYPE bigint:\n");
+	if (exec_or_die("ALTER TABLE nq_items ALTER COLUMN qty TYPE bigint") != 0)
+		failures++;
+	check_item("item 2", "2", "two", "20", 4);
+	check("insert a row", add_item("3", "three", "30"));
+	check_total("total", "60");
+
+	printf("After DROP COLUMN note:\n");
+	if (exec_or_die("ALTER TABLE nq_items DROP COLUMN note") != 0)
+		failures++;
+	check_item("item 3 has three columns", "3", "three", "30", 3);
+	check("insert a row", add_item("4", "four", "40"));
+	check_total("total", "100");
+
+	printf("After drop and recreate with another column order:\n");
+	if (exec_or_die("DROP TABLE nq_items") != 0 ||
+		exec_or_die("CREATE TABLE nq_items (qty NUMERIC NOT NULL, "
+					"id INTEGER PRIMARY KEY, name TEXT NOT NULL)") != 0)
+		failures++;
+	check("insert a row", add_item("5", "five", "50"));
+	check_item("item 5", "5", "five", "50", 3);
+	check_total("total", "50");
+
+	exec_or_die("DROP TABLE IF EXISTS nq_items");
+	pg_embedded_shutdown();
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
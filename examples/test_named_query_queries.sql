@@ -0,0 +1,10 @@
+-- Queries of test_named_query, compiled by helpers/querygen
+
+-- name: add_item
+INSERT INTO nq_items (id, name, qty) VALUES ($1, $2, $3);
+
+-- name: item_by_id
+SELECT * FROM nq_items WHERE id = $1;
+
+-- name: total_qty
+SELECT sum(qty) FROM nq_items;
@@ -0,0 +1,7 @@
+-- Schema test_named_query's queries are compiled against
+CREATE TABLE nq_items (
+	id INTEGER PRIMARY KEY,
+	name TEXT NOT NULL,
+	note TEXT,
+	qty INTEGER NOT NULL
+);
@@ -0,0 +1,153 @@
+/*
+ * test_plan_cache - Test the plan cache with literals of mixed types
+ *
+ * Usage: test_plan_cache <data_directory>
+ *
+ * Runs queries of one shape whose literals differ in type (int4 and int8
+ * integers, integers and decimals, strings) with the plan cache on, and
+ * checks each result against the query run as written, and whether it
+ * reused a plan, prepared one, or ran as written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+
+typedef enum expect
+{
+	HIT,
+	MISS,
+	AS_WRITTEN
+} expect;
+
+typedef struct test_case
+{
+	const char *where;
+	expect		expected;
+} test_case;
+
+static const test_case cases[] = {
+	{"id = 5", MISS},
+	{"id = 6", HIT},
+	{"id = 5000000000", MISS},	/* int8, not an int4 parameter */
+	{"id = 6000000000", HIT},
+	{"price > 1", MISS},
+	{"price > 9", HIT},
+	{"price > 1.5", MISS},		/* numeric, not an int4 parameter */
+	{"price > 9.5", HIT},
+	{"name = 'n3'", MISS},
+	{"name = 'big'", HIT},
+	{"id > -2147483648", MISS},	/* an int4 once negated */
+	{"id > -2147483649", AS_WRITTEN},	/* same shape, but not an int4 */
+};
+
+static int
+exec_or_die(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+
+	if (!result || result->status < 0)
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+		pg_embedded_free_result(result);
+		return -1;
+	}
+	pg_embedded_free_result(result);
+	return 0;
+}
+
+/* count(*) of the rows matching "where", malloc'd, or NULL on error */
+static char *
+count_where(const char *where)
+{
+	char		sql[256];
+	pg_result  *result;
+	char	   *count = NULL;
+
+	snprintf(sql, sizeof(sql), "SELECT count(*) FROM pc_items WHERE %s", where);
+	result = pg_embedded_exec(sql);
+	if (!result || result->status < 0)
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+	else if (result->rows == 1)
+		count = strdup(result->values[0][0]);
+	pg_embedded_free_result(result);
+	return count;
+}
+
+int
+main(int argc, char **argv)
+{
+	char	   *expected[sizeof(cases) / sizeof(cases[0])];
+	int			ncases = sizeof(cases) / sizeof(cases[0]);
+	int			failures = 0;
+	int			i;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	if (exec_or_die("DROP TABLE IF EXISTS pc_items") != 0 ||
+		exec_or_die("CREATE TABLE pc_items (id BIGINT PRIMARY KEY, "
+					"price NUMERIC, name TEXT)") != 0 ||
+		exec_or_die("INSERT INTO pc_items SELECT g, g, 'n' || g "
+					"FROM generate_series(1, 10) g") != 0 ||
+		exec_or_die("INSERT INTO pc_items VALUES (5000000000, 2.5, 'big')") != 0)
+	{
+		pg_embedded_shutdown();
+		return 1;
+	}
+
+	/* The results as written, with the cache off */
+	for (i = 0; i < ncases; i++)
+		expected[i] = count_where(cases[i].where);
+
+	pg_embedded_set_plan_cache_size(64);
+	for (i = 0; i < ncases; i++)
+	{
+		pg_plan_cache_stats before;
+		pg_plan_cache_stats after;
+		char	   *got;
+		int			ok;
+		expect		seen;
+
+		pg_embedded_plan_cache_stats(&before);
+		got = count_where(cases[i].where);
+		pg_embedded_plan_cache_stats(&after);
+
+		if (after.hits == before.hits + 1)
+			seen = HIT;
+		else if (after.misses == before.misses + 1)
+			seen = MISS;
+		else
+			seen = AS_WRITTEN;
+
+		ok = got && expected[i] && strcmp(got, expected[i]) == 0 &&
+			seen == cases[i].expected;
+		printf("  %-20s count=%-4s %-10s %s\n", cases[i].where,
+			   got ? got : "ERROR",
+			   seen == HIT ? "hit" : seen == MISS ? "miss" : "as written",
+			   ok ? "OK" : "FAILED");
+		if (!ok)
+			failures++;
+		free(got);
+		free(expected[i]);
+	}
+
+	pg_embedded_set_plan_cache_size(0);
+	exec_or_die("DROP TABLE IF EXISTS pc_items");
+	pg_embedded_shutdown();
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * test_reserve_ids - Test reserving blocks of sequence values
+ *
+ * Usage: test_reserve_ids <data_directory>
+ *
+ * Reserves blocks of values with pg_embedded_reserve_ids() from an
+ * ascending sequence with CACHE 20, a descending one and one with a small
+ * MAXVALUE, and checks the first value of each block, what nextval()
+ * returns after it, and that a block that would run past the sequence's
+ * bounds fails without cycling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+
+static int	failures = 0;
+
+static int
+exec_or_die(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+
+	if (!result || result->status < 0)
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+		pg_embedded_free_result(result);
+		return -1;
+	}
+	pg_embedded_free_result(result);
+	return 0;
+}
+
+static void
+check(const char *what, int ok)
+{
+	printf("  %-52s %s\n", what, ok ? "OK" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/* First value of a one-row query, compared with "expected" */
+static int
+query_is(const char *sql, const char *expected)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0 && result->rows == 1 &&
+		result->values[0][0] && strcmp(result->values[0][0], expected) == 0;
+
+	if (!result || result->status < 0)
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+/* Reserve n values and compare the first one with "expected" */
+static int
+reserve_is(const char *sequence, int64_t n, int64_t expected)
+{
+	int64_t		first = 0;
+
+	if (pg_embedded_reserve_ids(sequence, n, &first) != 0)
+	{
+		fprintf(stderr, "ERROR: %s\n", pg_embedded_error_message());
+		return 0;
+	}
+	return first == expected;
+}
+
+int
+main(int argc, char **argv)
+{
+	pg_embedded_config config = {
+		.fsync = true,
+		.synchronous_commit = true,
+		.full_page_writes = true,
+	};
+	int64_t		first = 0;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	pg_embedded_set_config(&config);
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	if (exec_or_die("DROP SEQUENCE IF EXISTS rs_up, rs_down, rs_max") != 0 ||
+		exec_or_die("CREATE SEQUENCE rs_up CACHE 20") != 0 ||
+		exec_or_die("CREATE SEQUENCE rs_down INCREMENT -3 "
+					"MINVALUE 1 MAXVALUE 100 START 100") != 0 ||
+		exec_or_die("CREATE SEQUENCE rs_max MAXVALUE 10 CACHE 5 CYCLE") != 0)
+	{
+		pg_embedded_shutdown();
+		return 1;
+	}
+
+	printf("CACHE 20:\n");
+	check("nextval() before reserving returns 1",
+		  query_is("SELECT nextval('rs_up')", "1"));
+	check("reserving 10 values starts at 2", reserve_is("rs_up", 10, 2));
+	check("nextval() continues after the block",
+		  query_is("SELECT nextval('rs_up')", "12"));
+	check("reserving 1 value is a nextval()", reserve_is("rs_up", 1, 13));
+	check("a reservation survives a rollback",
+		  pg_embedded_begin() == 0 && reserve_is("rs_up", 100, 14) &&
+		  pg_embedded_rollback() == 0 &&
+		  query_is("SELECT nextval('rs_up')", "114"));
+
+	printf("INCREMENT -3:\n");
+	check("reserving 5 values starts at 100", reserve_is("rs_down", 5, 100));
+	check("nextval() returns 85 after 100, 97, 94, 91, 88",
+		  query_is("SELECT nextval('rs_down')", "85"));
+	check("30 values past MINVALUE 1 cannot be reserved",
+		  pg_embedded_reserve_ids("rs_down", 30, &first) != 0 &&
+		  strstr(pg_embedded_error_message(), "cannot reserve") != NULL);
+	check("the 27 values left, 79 down to 1, can",
+		  reserve_is("rs_down", 27, 79));
+	check("the sequence is then exhausted",
+		  pg_embedded_reserve_ids("rs_down", 1, &first) != 0);
+
+	printf("MAXVALUE 10:\n");
+	check("reserving 4 values starts at 1", reserve_is("rs_max", 4, 1));
+	check("7 values past MAXVALUE cannot be reserved",
+		  pg_embedded_reserve_ids("rs_max", 7, &first) != 0 &&
+		  strstr(pg_embedded_error_message(), "cannot reserve") != NULL);
+	check("the value taken by the failed reservation is lost",
+		  query_is("SELECT nextval('rs_max')", "6"));
+	check("reserving 3 values starts at 7", reserve_is("rs_max", 3, 7));
+	check("a block of a CYCLE sequence does not wrap",
+		  pg_embedded_reserve_ids("rs_max", 2, &first) != 0);
+	check("nextval() cycles past the lost 10",
+		  query_is("SELECT nextval('rs_max')", "1"));
+
+	printf("Arguments:\n");
+	check("n = 0 is rejected", pg_embedded_reserve_ids("rs_up", 0, &first) != 0);
+	check("an unknown sequence is rejected",
+		  pg_embedded_reserve_ids("rs_missing", 2, &first) != 0);
+
+	exec_or_die("DROP SEQUENCE rs_up, rs_down, rs_max");
+	pg_embedded_shutdown();
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * test_transactions - Test errors inside host transactions
+ *
+ * Usage: test_transactions <data_directory>
+ *
+ * A statement that fails inside pg_embedded_begin() aborts the whole
+ * transaction.  Checks that its work is gone, that the next
+ * pg_embedded_exec() runs in a transaction of its own, and that begin,
+ * failure and exec can repeat without leaking into or reusing the
+ * aborted transaction's memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+
+#define ROUNDS 1000
+
+static int	failures = 0;
+
+static int
+exec_ok(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0;
+
+	if (!ok)
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+static int
+exec_fails(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			failed = !result || result->status < 0;
+
+	pg_embedded_free_result(result);
+	return failed;
+}
+
+static void
+check(const char *what, int ok)
+{
+	printf("  %-52s %s\n", what, ok ? "OK" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/* First value of a one-row query, compared with "expected" */
+static int
+query_is(const char *sql, const char *expected)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0 && result->rows == 1 &&
+		result->values[0][0] && strcmp(result->values[0][0], expected) == 0;
+
+	if (!result || result->status < 0)
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+	int			i;
+	int			ok;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	if (pg_embedded_init(argv[1], "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return 1;
+	}
+
+	if (!exec_ok("DROP TABLE IF EXISTS tx_items") ||
+		!exec_ok("CREATE TABLE tx_items (id INTEGER PRIMARY KEY, v TEXT)"))
+	{
+		pg_embedded_shutdown();
+		return 1;
+	}
+
+	printf("Begin, failing exec, exec:\n");
+	check("begin", pg_embedded_begin() == 0);
+	check("insert inside the transaction",
+		  exec_ok("INSERT INTO tx_items VALUES (1, 'rolled back')"));
+	check("failing statement reports an error",
+		  exec_fails("INSERT INTO tx_items VALUES (1, 'duplicate')"));
+	check("the transaction is gone", pg_embedded_commit() != 0);
+	check("next exec runs on its own",
+		  exec_ok("INSERT INTO tx_items VALUES (2, 'kept')"));
+	check("the first insert was rolled back",
+		  query_is("SELECT string_agg(v, ',' ORDER BY id) FROM tx_items", "kept"));
+
+	printf("Begin and commit after the failure:\n");
+	check("begin", pg_embedded_begin() == 0);
+	check("insert", exec_ok("INSERT INTO tx_items VALUES (3, 'committed')"));
+	check("commit", pg_embedded_commit() == 0);
+	check("row is there", query_is("SELECT count(*) FROM tx_items", "2"));
+
+	printf("Repeated %d times:\n", ROUNDS);
+	ok = 1;
+	for (i = 0; i < ROUNDS && ok; i++)
+	{
+		char		sql[128];
+
+		snprintf(sql, sizeof(sql),
+				 "INSERT INTO tx_items SELECT g, repeat('x', 1000) "
+				 "FROM generate_series(%d, %d) g", 1000 + i * 10, 1009 + i * 10);
+		ok = pg_embedded_begin() == 0 &&
+			exec_ok(sql) &&
+			exec_fails("SELECT 1 / 0") &&
+			exec_ok("SELECT count(*) FROM tx_items");
+	}
+	check("begin, insert, failure, exec", ok);
+	check("nothing from those rounds was kept",
+		  query_is("SELECT count(*) FROM tx_items", "2"));
+
+	exec_ok("DROP TABLE IF EXISTS tx_items");
+	pg_embedded_shutdown();
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
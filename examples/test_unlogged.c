@@ -0,0 +1,226 @@
+/*
+ * test_unlogged - Test unlogged-by-default tables
+ *
+ * Usage: test_unlogged <data_directory>
+ *
+ * A child process creates tables with pg_embedded_config.unlogged_tables
+ * set, with and without a per-schema override, makes a pair of tables
+ * linked by a foreign key permanent with pg_embedded_set_logged, and exits
+ * without shutting down.  The parent then starts on the same data
+ * directory and checks which tables crash recovery emptied, and that the
+ * report is empty again after a clean shutdown.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pgembedded.h"
+
+static int	failures = 0;
+
+static int
+exec_or_die(const char *sql)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+
+	if (!result || result->status < 0)
+	{
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+		pg_embedded_free_result(result);
+		return -1;
+	}
+	pg_embedded_free_result(result);
+	return 0;
+}
+
+static void
+check(const char *what, int ok)
+{
+	printf("  %-52s %s\n", what, ok ? "OK" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+/* First value of a one-row query, compared with "expected" */
+static int
+query_is(const char *sql, const char *expected)
+{
+	pg_result  *result = pg_embedded_exec(sql);
+	int			ok = result && result->status >= 0 && result->rows == 1 &&
+		result->values[0][0] && strcmp(result->values[0][0], expected) == 0;
+
+	if (!result || result->status < 0)
+		fprintf(stderr, "ERROR: %s: %s\n", sql, pg_embedded_error_message());
+	pg_embedded_free_result(result);
+	return ok;
+}
+
+static int
+persistence_is(const char *table, const char *expected)
+{
+	char		sql[256];
+
+	snprintf(sql, sizeof(sql),
+			 "SELECT relpersistence FROM pg_class WHERE oid = '%s'::regclass",
+			 table);
+	return query_is(sql, expected);
+}
+
+static int
+init(const char *datadir)
+{
+	pg_embedded_config config = {
+		.fsync = true,
+		.synchronous_commit = true,
+		.full_page_writes = true,
+		.unlogged_tables = true,
+	};
+
+	pg_embedded_set_config(&config);
+	if (pg_embedded_init(datadir, "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "ERROR: Initialization failed: %s\n",
+				pg_embedded_error_message());
+		return -1;
+	}
+	return 0;
+}
+
+/* The run that doesn't shut down; returns the exit status */
+static int
+child_run(const char *datadir)
+{
+	int64_t		converted;
+
+	/* Tables in "keep" stay permanent */
+	if (pg_embedded_set_schema_unlogged("keep", false) != 0 || init(datadir) != 0)
+		return 1;
+
+	if (exec_or_die("DROP TABLE IF EXISTS ul_plain, ul_ctas") != 0 ||
+		exec_or_die("DROP SCHEMA IF EXISTS keep, fk CASCADE") != 0 ||
+		exec_or_die("CREATE SCHEMA keep") != 0 ||
+		exec_or_die("CREATE SCHEMA fk") != 0)
+		return 1;
+
+	printf("Creating tables:\n");
+	check("CREATE TABLE is unlogged",
+		  exec_or_die("CREATE TABLE ul_plain (id int PRIMARY KEY, v text)") == 0 &&
+		  persistence_is("ul_plain", "u"));
+	check("its index is unlogged", persistence_is("ul_plain_pkey", "u"));
+	check("CREATE TABLE AS is unlogged",
+		  exec_or_die("CREATE TABLE ul_ctas AS SELECT g AS id FROM generate_series(1, 10) g") == 0 &&
+		  persistence_is("ul_ctas", "u"));
+	check("CREATE TABLE in schema keep is permanent",
+		  exec_or_die("CREATE TABLE keep.kept (id int)") == 0 &&
+		  persistence_is("keep.kept", "p"));
+	check("CREATE TEMP TABLE is temporary",
+		  exec_or_die("CREATE TEMP TABLE ul_temp (id int)") == 0 &&
+		  persistence_is("ul_temp", "t"));
+
+	printf("Making schema fk permanent:\n");
+	if (exec_or_die("CREATE TABLE fk.parent (id int PRIMARY KEY)") != 0 ||
+		exec_or_die("CREATE TABLE fk.child (id int PRIMARY KEY, "
+					"parent int REFERENCES fk.parent)") != 0 ||
+		exec_or_die("INSERT INTO fk.parent VALUES (1), (2)") != 0 ||
+		exec_or_die("INSERT INTO fk.child VALUES (10, 1), (20, 2)") != 0)
+		return 1;
+	converted = pg_embedded_set_logged("fk");
+	if (converted < 0)
+		fprintf(stderr, "ERROR: %s\n", pg_embedded_error_message());
+	check("pg_embedded_set_logged converts both tables", converted == 2);
+	check("referenced table is permanent", persistence_is("fk.parent", "p"));
+	check("referencing table is permanent", persistence_is("fk.child", "p"));
+	check("ul_plain is still unlogged", persistence_is("ul_plain", "u"));
+
+	if (exec_or_die("INSERT INTO ul_plain VALUES (1, 'lost')") != 0 ||
+		exec_or_die("INSERT INTO keep.kept VALUES (1)") != 0)
+		return 1;
+
+	/* Exit like a crash: no shutdown, no atexit handlers */
+	fflush(stdout);
+	_exit(failures ? 1 : 0);
+}
+
+int
+main(int argc, char **argv)
+{
+	pg_unlogged_reset reset;
+	pid_t		pid;
+	int			status;
+	int			i;
+	int			saw_plain = 0;
+	int			saw_ctas = 0;
+	int			saw_other = 0;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <data_directory>\n", argv[0]);
+		return 1;
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+	{
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0)
+		_exit(child_run(argv[1]));
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+		WEXITSTATUS(status) != 0)
+	{
+		fprintf(stderr, "ERROR: the first run failed\n");
+		return 1;
+	}
+
+	printf("After the unclean stop:\n");
+	if (init(argv[1]) != 0)
+		return 1;
+	if (pg_embedded_unlogged_reset(&reset) != 0)
+	{
+		fprintf(stderr, "ERROR: %s\n", pg_embedded_error_message());
+		pg_embedded_shutdown();
+		return 1;
+	}
+	for (i = 0; i < reset.ntables; i++)
+	{
+		if (strcmp(reset.tables[i], "public.ul_plain") == 0)
+			saw_plain = 1;
+		else if (strcmp(reset.tables[i], "public.ul_ctas") == 0)
+			saw_ctas = 1;
+		else if (strncmp(reset.tables[i], "keep.", 5) == 0 ||
+				 strncmp(reset.tables[i], "fk.", 3) == 0)
+			saw_other = 1;
+	}
+	check("the crash is reported", reset.crashed);
+	check("ul_plain and ul_ctas were emptied", saw_plain && saw_ctas);
+	check("no permanent table is listed", !saw_other);
+	pg_embedded_free_unlogged_reset(&reset);
+
+	check("ul_plain is empty", query_is("SELECT count(*) FROM ul_plain", "0"));
+	check("keep.kept kept its row", query_is("SELECT count(*) FROM keep.kept", "1"));
+	check("fk.child kept its rows", query_is("SELECT count(*) FROM fk.child", "2"));
+	pg_embedded_shutdown();
+
+	printf("After a clean shutdown:\n");
+	if (init(argv[1]) != 0)
+		return 1;
+	if (pg_embedded_unlogged_reset(&reset) == 0)
+	{
+		check("no crash is reported", !reset.crashed && reset.ntables == 0);
+		pg_embedded_free_unlogged_reset(&reset);
+	}
+	else
+		check("no crash is reported", 0);
+
+	exec_or_die("DROP TABLE IF EXISTS ul_plain, ul_ctas");
+	exec_or_die("DROP SCHEMA IF EXISTS keep, fk CASCADE");
+	pg_embedded_shutdown();
+
+	printf("%s\n", failures ? "FAILED" : "All checks passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * querygen.c - Precompile an application's named queries at build time
+ *
+ * Usage: querygen <schema.sql> <queries.sql> <output.h>
+ *
+ * Creates a scratch cluster, runs schema.sql in it, then analyzes every
+ * query in queries.sql against that schema and writes a header with the
+ * analyzed Query trees, for pg_embedded_register_named_queries().  Any SQL
+ * error in the schema or the queries fails the build.
+ *
+ * queries.sql holds one statement per query, each introduced by a
+ * "-- name: <identifier>" line:
+ *
+ *   -- name: user_by_id
+ *   SELECT id, name FROM users WHERE id = $1;
+ *
+ * The header defines an enum with a QUERY_<IDENTIFIER> id for each query
+ * (plus NAMED_QUERY_COUNT) and a static pg_named_query named_queries[].
+ *
+ * Run the application's pg_embedded_init against a database set up with
+ * the same schema.sql so that relation OIDs match; otherwise the queries
+ * still work but are analyzed once at runtime.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <ctype.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "pgembedded.h"
+
+typedef struct manifest_query
+{
+	char	   *name;
+	char	   *sql;
+} manifest_query;
+
+static char *
+read_file(const char *path)
+{
+	FILE	   *f = fopen(path, "rb");
+	char	   *buf;
+	long		len;
+
+	if (!f)
+	{
+		perror(path);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = malloc(len + 1);
+	if (!buf || fread(buf, 1, len, f) != (size_t) len)
+	{
+		fprintf(stderr, "%s: read failed\n", path);
+		fclose(f);
+		free(buf);
+		return NULL;
+	}
+	buf[len] = '\0';
+	fclose(f);
+	return buf;
+}
+
+/* Trim whitespace and a trailing semicolon in place */
+static char *
+trim_sql(char *sql)
+{
+	char	   *end;
+
+	while (isspace((unsigned char) *sql))
+		sql++;
+	end = sql + strlen(sql);
+	while (end > sql && (isspace((unsigned char) end[-1]) || end[-1] == ';'))
+		*--end = '\0';
+	return sql;
+}
+
+/* Split the manifest at its "-- name:" lines; returns the number of queries */
+static int
+parse_manifest(char *text, manifest_query **out)
+{
+	const char *marker = "-- name:";
+	manifest_query *queries = NULL;
+	int			count = 0;
+	char	   *p = text;
+
+	while ((p = strstr(p, marker)) != NULL)
+	{
+		char	   *name;
+		char	   *sql;
+		char	   *next;
+
+		if (p != text && p[-1] != '\n')
+		{
+			p += strlen(marker);
+			continue;
+		}
+
+		name = p + strlen(marker);
+		while (*name == ' ' || *name == '\t')
+			name++;
+		sql = strchr(name, '\n');
+		if (!sql)
+			sql = name + strlen(name);
+		else
+			*sql++ = '\0';
+
+		next = strstr(sql, "\n-- name:");
+		if (next)
+			*next = '\0';
+
+		queries = realloc(queries, (count + 1) * sizeof(manifest_query));
+		queries[count].name = trim_sql(name);
+		queries[count].sql = trim_sql(sql);
+		count++;
+
+		if (!next)
+			break;
+		p = next + 1;
+	}
+
+	*out = queries;
+	return count;
+}
+
+static int
+valid_identifier(const char *name)
+{
+	if (!isalpha((unsigned char) *name) && *name != '_')
+		return 0;
+	for (; *name; name++)
+	{
+		if (!isalnum((unsigned char) *name) && *name != '_')
+			return 0;
+	}
+	return 1;
+}
+
+/* Write a C string literal, split over lines of bounded length */
+static void
+write_literal(FILE *f, const char *s)
+{
+	int			col = 0;
+
+	fputs("\n\t\t\"", f);
+	for (; *s; s++)
+	{
+		if (col >= 72)
+		{
+			fputs("\"\n\t\t\"", f);
+			col = 0;
+		}
+		switch (*s)
+		{
+			case '"':
+				fputs("\\\"", f);
+				col += 2;
+				break;
+			case '\\':
+				fputs("\\\\", f);
+				col += 2;
+				break;
+			case '\n':
+				fputs("\\n", f);
+				col += 2;
+				break;
+			case '\t':
+				fputs("\\t", f);
+				col += 2;
+				break;
+			default:
+				if ((unsigned char) *s < 0x20)
+				{
+					fprintf(f, "\\%03o", (unsigned char) *s);
+					col += 4;
+				}
+				else
+				{
+					fputc(*s, f);
+					col++;
+				}
+		}
+	}
+	fputc('"', f);
+}
+
+static int
+remove_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftw)
+{
+	return remove(path);
+}
+
+int
+main(int argc, char **argv)
+{
+	char		datadir[] = "/tmp/querygen-XXXXXX";
+	manifest_query *queries;
+	char	   *schema;
+	char	   *manifest;
+	pg_result  *res;
+	FILE	   *out;
+	int			count;
+	int			failed = 0;
+	int			i;
+	int			j;
+
+	if (argc != 4)
+	{
+		fprintf(stderr, "Usage: %s <schema.sql> <queries.sql> <output.h>\n",
+				argv[0]);
+		return 1;
+	}
+
+	schema = read_file(argv[1]);
+	manifest = read_file(argv[2]);
+	if (!schema || !manifest)
+		return 1;
+
+	count = parse_manifest(manifest, &queries);
+	for (i = 0; i < count; i++)
+	{
+		if (!valid_identifier(queries[i].name))
+		{
+			fprintf(stderr, "%s: invalid query name \"%s\"\n",
+					argv[2], queries[i].name);
+			return 1;
+		}
+
+		/* Names differing only in case would give the same QUERY_ constant */
+		for (j = 0; j < i; j++)
+		{
+			if (strcasecmp(queries[i].name, queries[j].name) == 0)
+			{
+				fprintf(stderr, "%s: query name \"%s\" is used twice (queries %d and %d)\n",
+						argv[2], queries[i].name, j + 1, i + 1);
+				return 1;
+			}
+		}
+	}
+
+	if (!mkdtemp(datadir))
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	/* initdb wants to create the directory itself */
+	rmdir(datadir);
+
+	if (pg_embedded_initdb(datadir, "postgres", "UTF8", "C") != 0 ||
+		pg_embedded_init(datadir, "postgres", "postgres") != 0)
+	{
+		fprintf(stderr, "querygen: could not set up a cluster: %s\n",
+				pg_embedded_error_message());
+		nftw(datadir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+		return 1;
+	}
+
+	res = pg_embedded_exec(schema);
+	if (!res || res->status < 0)
+	{
+		fprintf(stderr, "%s: %s\n", argv[1], pg_embedded_error_message());
+		failed = 1;
+	}
+	pg_embedded_free_result(res);
+
+	out = failed ? NULL : fopen(argv[3], "w");
+	if (!failed && !out)
+	{
+		perror(argv[3]);
+		failed = 1;
+	}
+
+	if (out)
+	{
+		pg_compiled_query *compiled = calloc(count ? count : 1,
+											 sizeof(pg_compiled_query));
+
+		for (i = 0; i < count; i++)
+		{
+			if (pg_embedded_compile_query(queries[i].sql, &compiled[i]) != 0)
+			{
+				fprintf(stderr, "%s: query \"%s\": %s\n",
+						argv[2], queries[i].name, pg_embedded_error_message());
+				failed = 1;
+			}
+		}
+
+		fprintf(out, "/*\n * Generated by helpers/querygen from %s - do not edit\n */\n\n",
+				argv[2]);
+		fprintf(out, "#ifndef NAMED_QUERIES_H\n#define NAMED_QUERIES_H\n\n");
+		fprintf(out, "#include \"pgembedded.h\"\n\nenum\n{\n");
+		for (i = 0; i < count; i++)
+		{
+			fputs("\tQUERY_", out);
+			for (j = 0; queries[i].name[j]; j++)
+				fputc(toupper((unsigned char) queries[i].name[j]), out);
+			fputs(",\n", out);
+		}
+		fprintf(out, "\tNAMED_QUERY_COUNT\n};\n\n");
+
+		for (i = 0; i < count; i++)
+		{
+			fprintf(out, "static const unsigned int named_query_%s_params[] = {",
+					queries[i].name);
+			for (j = 0; j < compiled[i].nparams; j++)
+				fprintf(out, "%s%u", j ? ", " : "", compiled[i].param_types[j]);
+			fprintf(out, "%s};\n", compiled[i].nparams ? "" : "0");
+		}
+
+		fprintf(out, "\nstatic const pg_named_query named_queries[] = {\n");
+		for (i = 0; i < count; i++)
+		{
+			fprintf(out, "\t{\n\t\t\"%s\",", queries[i].name);
+			write_literal(out, queries[i].sql);
+			fputc(',', out);
+			write_literal(out, compiled[i].query ? compiled[i].query : "");
+			fputc(',', out);
+			write_literal(out, compiled[i].relations ? compiled[i].relations : "");
+			fprintf(out, ",\n\t\t%uU, %d, named_query_%s_params\n\t},\n",
+					compiled[i].catversion, compiled[i].nparams,
+					queries[i].name);
+			pg_embedded_free_compiled_query(&compiled[i]);
+		}
+		fprintf(out, "};\n\n#endif /* NAMED_QUERIES_H */\n");
+
+		free(compiled);
+		if (fclose(out) != 0)
+			failed = 1;
+		if (failed)
+			remove(argv[3]);
+	}
+
+	pg_embedded_shutdown();
+	nftw(datadir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+	if (!failed)
+		printf("querygen: %d queries written to %s\n", count, argv[3]);
+	return failed;
+}
@@ -0,0 +1,289 @@
+/*-------------------------------------------------------------------------
+ *
+ * embedded_shmem.c
+ *	  Private-memory shared memory and semaphores for the embedded backend
+ *
+ * Only one backend ever runs in embedded mode, so "shared" memory doesn't
+ * need to be shared with anyone.  With PRIVATE_SHMEM=1 this file replaces
+ * port/pg_shmem.o and port/pg_sema.o in libpostgres.a:
+ *
+ * - The main segment is an anonymous private mapping, with huge pages as
+ *   the huge_pages and huge_page_size settings ask.  There is no SysV
+ *   segment, so nothing is left behind after a crash and startup doesn't
+ *   have to look for a previous segment.
+ *
+ * - Semaphores are plain counters in that segment.  A process can only
+ *   wait on a semaphore for another process to release it, which can't
+ *   happen here, so a wait on a zero count is a self-deadlock.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/embedded_shmem.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "miscadmin.h"
+#include "port/pg_bitutils.h"
+#include "storage/ipc.h"
+#include "storage/pg_sema.h"
+#include "storage/pg_shmem.h"
+#include "storage/shmem.h"
+#include "utils/guc.h"
+#include "utils/guc_hooks.h"
+
+/* Also set by port/sysv_shmem.c; pg_reset.c clears UsedShmemSegID */
+unsigned long UsedShmemSegID = 0;
+void	   *UsedShmemSegAddr = NULL;
+
+/* pg_embedded_config.huge_pages is PG_HUGE_PAGES_TRANSPARENT (pg_memory.c) */
+extern bool shmem_thp_requested;
+
+static void *private_shmem = NULL;
+static Size private_shmem_size = 0;
+
+typedef struct PGSemaphoreData
+{
+	int			count;
+} PGSemaphoreData;
+
+static PGSemaphore sema_array = NULL;
+static int	num_semas = 0;
+static int	max_semas = 0;
+
+/*
+ * GetHugePageSize
+ *
+ * As in port/sysv_shmem.c: huge_page_size if set, else the kernel's
+ * default, and the mmap() flags that select it.
+ */
+void
+GetHugePageSize(Size *hugepagesize, int *mmap_flags)
+{
+	Size		default_hugepagesize = 0;
+	Size		size;
+	int			flags = MAP_HUGETLB;
+	FILE	   *fp = fopen("/proc/meminfo", "r");
+
+	if (fp)
+	{
+		char		buf[128];
+		unsigned int sz;
+		char		ch;
+
+		while (fgets(buf, sizeof(buf), fp))
+		{
+			if (sscanf(buf, "Hugepagesize: %u %c", &sz, &ch) == 2 && ch == 'k')
+			{
+				default_hugepagesize = sz * (Size) 1024;
+				break;
+			}
+		}
+		fclose(fp);
+	}
+
+	if (huge_page_size != 0)
+		size = (Size) huge_page_size * 1024;
+	else if (default_hugepagesize != 0)
+		size = default_hugepagesize;
+	else
+		size = 2 * 1024 * 1024;
+
+#if defined(MAP_HUGE_MASK) && defined(MAP_HUGE_SHIFT)
+	if (size != default_hugepagesize)
+		flags |= (pg_ceil_log2_64(size) & MAP_HUGE_MASK) << MAP_HUGE_SHIFT;
+#endif
+
+	if (hugepagesize)
+		*hugepagesize = size;
+	if (mmap_flags)
+		*mmap_flags = flags;
+}
+
+bool
+check_huge_page_size(int *newval, void **extra, GucSource source)
+{
+#if !(defined(MAP_HUGE_MASK) && defined(MAP_HUGE_SHIFT))
+	if (*newval != 0)
+	{
+		GUC_check_errdetail("\"huge_page_size\" must be 0 on this platform.");
+		return false;
+	}
+#endif
+	return true;
+}
+
+/* No segment outlives the process, so there is never one in use */
+bool
+PGSharedMemoryIsInUse(unsigned long id1, unsigned long id2)
+{
+	return false;
+}
+
+static void
+private_shmem_detach(int status, Datum arg)
+{
+	PGSharedMemoryDetach();
+}
+
+/*
+ * PGSharedMemoryCreate
+ *
+ * Map the segment, fall back to normal pages if huge pages were only
+ * tried, and set huge_pages_status to what was granted.
+ */
+PGShmemHeader *
+PGSharedMemoryCreate(Size size, PGShmemHeader **shim)
+{
+	PGShmemHeader *hdr;
+	struct stat statbuf;
+	void	   *ptr = MAP_FAILED;
+	int			mmap_errno = 0;
+
+	if (size < MAXALIGN(sizeof(PGShmemHeader)))
+		elog(PANIC, "shared memory segment size is too small: %zu", size);
+
+	if (huge_pages == HUGE_PAGES_ON || huge_pages == HUGE_PAGES_TRY)
+	{
+		Size		hugepagesize;
+		Size		allocsize = size;
+		int			mmap_flags;
+
+		GetHugePageSize(&hugepagesize, &mmap_flags);
+		if (allocsize % hugepagesize != 0)
+			allocsize += hugepagesize - (allocsize % hugepagesize);
+
+		ptr = mmap(NULL, allocsize, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | mmap_flags, -1, 0);
+		mmap_errno = errno;
+		if (ptr != MAP_FAILED)
+			size = allocsize;
+		else if (huge_pages == HUGE_PAGES_ON)
+			ereport(FATAL,
+					(errmsg("could not map %zu bytes of private memory with huge pages: %m",
+							allocsize)));
+	}
+
+	SetConfigOption("huge_pages_status", ptr != MAP_FAILED ? "on" : "off",
+					PGC_INTERNAL, PGC_S_DYNAMIC_DEFAULT);
+
+	if (ptr == MAP_FAILED)
+	{
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		mmap_errno = errno;
+	}
+	if (ptr == MAP_FAILED)
+	{
+		errno = mmap_errno;
+		ereport(FATAL,
+				(errmsg("could not map %zu bytes of private memory: %m", size)));
+	}
+
+#ifdef MADV_HUGEPAGE
+	/* Before anything, the WAL buffers included, is written to it */
+	if (shmem_thp_requested && madvise(ptr, size, MADV_HUGEPAGE) != 0)
+		elog(LOG, "madvise(MADV_HUGEPAGE) of %zu bytes failed: %m", size);
+#endif
+
+	private_shmem = ptr;
+	private_shmem_size = size;
+	on_shmem_exit(private_shmem_detach, (Datum) 0);
+
+	/* The mapping is zero-filled, only set what isn't zero */
+	hdr = (PGShmemHeader *) ptr;
+	hdr->creatorPID = getpid();
+	hdr->magic = PGShmemMagic;
+	if (stat(DataDir, &statbuf) < 0)
+		ereport(FATAL,
+				(errcode_for_file_access(),
+				 errmsg("could not stat data directory \"%s\": %m", DataDir)));
+	hdr->device = statbuf.st_dev;
+	hdr->inode = statbuf.st_ino;
+	hdr->totalsize = size;
+	hdr->freeoffset = MAXALIGN(sizeof(PGShmemHeader));
+
+	*shim = hdr;
+	UsedShmemSegAddr = hdr;
+	UsedShmemSegID = 0;
+
+	return hdr;
+}
+
+void
+PGSharedMemoryDetach(void)
+{
+	if (private_shmem != NULL)
+	{
+		if (munmap(private_shmem, private_shmem_size) < 0)
+			elog(LOG, "munmap(%p, %zu) failed: %m",
+				 private_shmem, private_shmem_size);
+		private_shmem = NULL;
+		private_shmem_size = 0;
+	}
+	UsedShmemSegAddr = NULL;
+	sema_array = NULL;
+}
+
+Size
+PGSemaphoreShmemSize(int maxSemas)
+{
+	return mul_size(maxSemas, sizeof(PGSemaphoreData));
+}
+
+void
+PGReserveSemaphores(int maxSemas)
+{
+	sema_array = (PGSemaphore) ShmemAllocUnlocked(PGSemaphoreShmemSize(maxSemas));
+	num_semas = 0;
+	max_semas = maxSemas;
+}
+
+PGSemaphore
+PGSemaphoreCreate(void)
+{
+	PGSemaphore sema;
+
+	if (num_semas >= max_semas)
+		elog(PANIC, "too many semaphores created");
+
+	sema = &sema_array[num_semas++];
+	sema->count = 1;
+	return sema;
+}
+
+void
+PGSemaphoreReset(PGSemaphore sema)
+{
+	sema->count = 0;
+}
+
+void
+PGSemaphoreLock(PGSemaphore sema)
+{
+	if (sema->count <= 0)
+		elog(PANIC, "semaphore wait in a single-backend process would never end");
+	sema->count--;
+}
+
+void
+PGSemaphoreUnlock(PGSemaphore sema)
+{
+	sema->count++;
+}
+
+bool
+PGSemaphoreTryLock(PGSemaphore sema)
+{
+	if (sema->count <= 0)
+		return false;
+	sema->count--;
+	return true;
+}
@@ -26,6 +26,21 @@ while IFS= read -r file; do
        			# Paths like src/timezone/*.o or src/common/*.a
        			echo "ADDMOD ../vendor/pg18/$file" >> libpostgres.mri;
        			;;
+       		port/pg_shmem.o|port/pg_sema.o)
+       			# Replaced by embedded_shmem.o when built with PRIVATE_SHMEM=1
+       			if [ "${PRIVATE_SHMEM:-0}" != 1 ]; then
+       				echo "ADDMOD ../vendor/pg18/src/backend/$file" >> libpostgres.mri;
+       			fi
+       			;;
+       		utils/mmgr/aset.o|utils/mmgr/generation.o|utils/mmgr/slab.o|utils/mmgr/bump.o)
+       			# Memory context blocks go through pg_memory.c's accounting
+       			mmgr_obj="mmgr_$(basename "$file")"
+       			objcopy --redefine-sym malloc=pg_mmgr_malloc \
+       				--redefine-sym realloc=pg_mmgr_realloc \
+       				--redefine-sym free=pg_mmgr_free \
+       				"../vendor/pg18/src/backend/$file" "$mmgr_obj"
+       			echo "ADDMOD $mmgr_obj" >> libpostgres.mri;
+       			;;
        		*.o)
        			# Backend object files like access/brin/brin.o
        			echo "ADDMOD ../vendor/pg18/src/backend/$file" >> libpostgres.mri;
@@ -34,7 +49,12 @@ while IFS= read -r file; do
     fi;
 done < "$libs_file"
 
+# Libraries PostgreSQL was configured with (liburing etc.)
+for lib in ${EXTRA_LIBS:-}; do
+	echo "ADDLIB $lib" >> libpostgres.mri;
+done
+
 echo "SAVE" >> libpostgres.mri
 echo "END" >> libpostgres.mri
 ar -M < libpostgres.mri
-rm -f libpostgres.mri
+rm -f libpostgres.mri mmgr_*.o
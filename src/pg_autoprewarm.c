@@ -0,0 +1,453 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_autoprewarm.c
+ *	  In-process autoprewarm for the PostgreSQL Embedded API
+ *
+ * The equivalent of contrib/pg_prewarm's autoprewarm worker, without a
+ * background worker: the list of blocks in shared buffers is saved to the
+ * data directory at pg_embedded_shutdown(), and read back after
+ * pg_embedded_init(), sorted by relation, fork and block so that the reads
+ * are sequential and go through read streams.  Loading happens either
+ * during pg_embedded_init() or in host-driven slices.
+ *
+ * Only blocks of the current database and of shared catalogs are saved,
+ * since only those can be mapped back to relations here.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_autoprewarm.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/relation.h"
+#include "access/xact.h"
+#include "miscadmin.h"
+#include "storage/buf_internals.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/read_stream.h"
+#include "storage/smgr.h"
+#include "utils/rel.h"
+#include "utils/relfilenumbermap.h"
+#include "utils/timestamp.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/* Relative to the data directory, which is the working directory */
+#define AUTOPREWARM_FILE		"pg_embedded_prewarm"
+#define AUTOPREWARM_MAGIC		0x50475057	/* "PGPW" */
+
+typedef struct PrewarmBlock
+{
+	Oid			database;
+	Oid			tablespace;
+	RelFileNumber filenumber;
+	ForkNumber	forknum;
+	BlockNumber blocknum;
+} PrewarmBlock;
+
+typedef struct PrewarmFileHeader
+{
+	uint32		magic;
+	uint32		blcksz;
+	uint64		nblocks;
+} PrewarmFileHeader;
+
+/* Blocks still to be loaded, malloc'd */
+static PrewarmBlock *prewarm_blocks = NULL;
+static int64 prewarm_nblocks = 0;
+static int64 prewarm_pos = 0;
+
+/* State of the read stream over one fork of one relation */
+typedef struct PrewarmStreamState
+{
+	int64		pos;
+	int64		end;
+	BlockNumber nblocks;		/* size of the fork now */
+	TimestampTz deadline;
+	bool		pool_full;
+	bool		out_of_time;
+} PrewarmStreamState;
+
+/*
+ * autoprewarm_dump
+ *
+ * Save the tags of all valid, permanent buffers, as contrib's
+ * apw_dump_now() does.  Returns the number of blocks saved, or -1 with
+ * the reason in pg_error_msg.
+ */
+int64_t
+autoprewarm_dump(void)
+{
+	PrewarmFileHeader header;
+	PrewarmBlock *blocks;
+	FILE	   *file;
+	int64		n = 0;
+	int			i;
+
+	blocks = host_malloc(Max(NBuffers, 1) * sizeof(PrewarmBlock));
+	if (!blocks)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+		return -1;
+	}
+
+	for (i = 0; i < NBuffers; i++)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(i);
+		uint32		buf_state = LockBufHdr(bufHdr);
+
+		if ((buf_state & BM_TAG_VALID) && (buf_state & BM_PERMANENT) &&
+			(bufHdr->tag.dbOid == MyDatabaseId ||
+			 bufHdr->tag.dbOid == InvalidOid))
+		{
+			blocks[n].database = bufHdr->tag.dbOid;
+			blocks[n].tablespace = bufHdr->tag.spcOid;
+			blocks[n].filenumber = BufTagGetRelNumber(&bufHdr->tag);
+			blocks[n].forknum = BufTagGetForkNum(&bufHdr->tag);
+			blocks[n].blocknum = bufHdr->tag.blockNum;
+			n++;
+		}
+
+		UnlockBufHdr(bufHdr, buf_state);
+	}
+
+	header.magic = AUTOPREWARM_MAGIC;
+	header.blcksz = BLCKSZ;
+	header.nblocks = n;
+
+	/* Write to a temporary file and rename, so a crash can't leave half */
+	file = AllocateFile(AUTOPREWARM_FILE ".tmp", PG_BINARY_W);
+	if (!file)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Could not create \"%s\": %m", AUTOPREWARM_FILE ".tmp");
+		host_free(blocks);
+		return -1;
+	}
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+		(n > 0 && fwrite(blocks, sizeof(PrewarmBlock), n, file) != (size_t) n))
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Could not write \"%s\": %m", AUTOPREWARM_FILE ".tmp");
+		FreeFile(file);
+		unlink(AUTOPREWARM_FILE ".tmp");
+		host_free(blocks);
+		return -1;
+	}
+	host_free(blocks);
+
+	if (FreeFile(file) != 0)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Could not close \"%s\": %m", AUTOPREWARM_FILE ".tmp");
+		unlink(AUTOPREWARM_FILE ".tmp");
+		return -1;
+	}
+	if (rename(AUTOPREWARM_FILE ".tmp", AUTOPREWARM_FILE) != 0)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Could not rename \"%s\" to \"%s\": %m",
+				 AUTOPREWARM_FILE ".tmp", AUTOPREWARM_FILE);
+		unlink(AUTOPREWARM_FILE ".tmp");
+		return -1;
+	}
+
+	return n;
+}
+
+static int
+prewarm_block_cmp(const void *a, const void *b)
+{
+	const PrewarmBlock *pa = (const PrewarmBlock *) a;
+	const PrewarmBlock *pb = (const PrewarmBlock *) b;
+
+	if (pa->database != pb->database)
+		return pa->database < pb->database ? -1 : 1;
+	if (pa->tablespace != pb->tablespace)
+		return pa->tablespace < pb->tablespace ? -1 : 1;
+	if (pa->filenumber != pb->filenumber)
+		return pa->filenumber < pb->filenumber ? -1 : 1;
+	if (pa->forknum != pb->forknum)
+		return pa->forknum < pb->forknum ? -1 : 1;
+	if (pa->blocknum != pb->blocknum)
+		return pa->blocknum < pb->blocknum ? -1 : 1;
+	return 0;
+}
+
+/*
+ * autoprewarm_load
+ *
+ * Read the saved block list after startup.  With upfront set, load all of
+ * it now; otherwise leave it to pg_embedded_prewarm().  A missing or
+ * unusable file just means there is nothing to prewarm.
+ */
+void
+autoprewarm_load(bool upfront)
+{
+	PrewarmFileHeader header;
+	FILE	   *file;
+
+	host_free(prewarm_blocks);
+	prewarm_blocks = NULL;
+	prewarm_nblocks = prewarm_pos = 0;
+
+	file = AllocateFile(AUTOPREWARM_FILE, PG_BINARY_R);
+	if (!file)
+		return;
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		header.magic != AUTOPREWARM_MAGIC || header.blcksz != BLCKSZ ||
+		header.nblocks == 0 || header.nblocks > (uint64) NBuffers * 4)
+	{
+		FreeFile(file);
+		return;
+	}
+
+	prewarm_blocks = host_malloc(header.nblocks * sizeof(PrewarmBlock));
+	if (!prewarm_blocks ||
+		fread(prewarm_blocks, sizeof(PrewarmBlock), header.nblocks, file) != header.nblocks)
+	{
+		FreeFile(file);
+		host_free(prewarm_blocks);
+		prewarm_blocks = NULL;
+		return;
+	}
+	FreeFile(file);
+
+	prewarm_nblocks = header.nblocks;
+	qsort(prewarm_blocks, prewarm_nblocks, sizeof(PrewarmBlock),
+		  prewarm_block_cmp);
+
+	/* A failure to prewarm must not fail the startup */
+	if (upfront && pg_embedded_prewarm(0) < 0)
+		fprintf(stderr, "[WARN] %s\n", pg_error_msg);
+}
+
+/*
+ * prewarm_next_block
+ *
+ * Read stream callback handing out the saved blocks of one fork.  Stops
+ * when the buffer pool has no free buffers left (prewarming would only
+ * evict other prewarmed blocks) or the time budget is used up.
+ */
+static BlockNumber
+prewarm_next_block(ReadStream *stream, void *callback_private_data,
+				   void *per_buffer_data)
+{
+	PrewarmStreamState *p = callback_private_data;
+
+	while (p->pos < p->end)
+	{
+		BlockNumber blocknum;
+
+		if (!have_free_buffer())
+		{
+			p->pool_full = true;
+			return InvalidBlockNumber;
+		}
+
+		/* Checking the clock for every block would be a waste */
+		if (p->deadline != 0 && p->pos % 64 == 0 &&
+			GetCurrentTimestamp() >= p->deadline)
+		{
+			p->out_of_time = true;
+			return InvalidBlockNumber;
+		}
+
+		blocknum = prewarm_blocks[p->pos++].blocknum;
+
+		/* The relation may have been truncated since */
+		if (blocknum < p->nblocks)
+			return blocknum;
+	}
+
+	return InvalidBlockNumber;
+}
+
+/*
+ * prewarm_relation
+ *
+ * Load the saved blocks of one relation, which start at prewarm_pos and
+ * end before "end".  Returns false if loading has to stop.
+ */
+static bool
+prewarm_relation(int64 end, TimestampTz deadline)
+{
+	PrewarmBlock *first = &prewarm_blocks[prewarm_pos];
+	Relation	rel;
+	Oid			relid;
+
+	relid = RelidByRelfilenumber(first->tablespace, first->filenumber);
+	rel = OidIsValid(relid) ? try_relation_open(relid, AccessShareLock) : NULL;
+	if (rel == NULL)
+	{
+		/* Dropped or rewritten since the list was saved */
+		prewarm_pos = end;
+		return true;
+	}
+
+	while (prewarm_pos < end)
+	{
+		ForkNumber	forknum = prewarm_blocks[prewarm_pos].forknum;
+		PrewarmStreamState p;
+		ReadStream *stream;
+		Buffer		buf;
+
+		memset(&p, 0, sizeof(p));
+		p.pos = prewarm_pos;
+		p.end = prewarm_pos;
+		while (p.end < end && prewarm_blocks[p.end].forknum == forknum)
+			p.end++;
+		p.deadline = deadline;
+
+		if (forknum > MAX_FORKNUM ||
+			!smgrexists(RelationGetSmgr(rel), forknum))
+		{
+			prewarm_pos = p.end;
+			continue;
+		}
+		p.nblocks = RelationGetNumberOfBlocksInFork(rel, forknum);
+
+		stream = read_stream_begin_relation(READ_STREAM_FULL, NULL, rel,
+											forknum, prewarm_next_block,
+											&p, 0);
+		while ((buf = read_stream_next_buffer(stream, NULL)) != InvalidBuffer)
+			ReleaseBuffer(buf);
+		read_stream_end(stream);
+
+		prewarm_pos = p.pos;
+
+		if (p.pool_full)
+		{
+			/* Nothing more will fit; forget the rest */
+			prewarm_pos = prewarm_nblocks;
+			break;
+		}
+		if (p.out_of_time)
+			break;
+	}
+
+	relation_close(rel, AccessShareLock);
+
+	return prewarm_pos >= end;
+}
+
+/*
+ * pg_embedded_prewarm
+ *
+ * Load saved blocks for up to budget_us microseconds (0 = no limit).
+ */
+int64_t
+pg_embedded_prewarm(uint64_t budget_us)
+{
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot prewarm inside a transaction");
+		return -1;
+	}
+
+	if (prewarm_pos >= prewarm_nblocks)
+		return 0;
+
+	PG_TRY();
+	{
+		TimestampTz deadline = 0;
+
+		if (budget_us > 0)
+			deadline = TimestampTzPlusMicroseconds(GetCurrentTimestamp(),
+												   (int64) budget_us);
+
+		StartTransactionCommand();
+
+		while (prewarm_pos < prewarm_nblocks)
+		{
+			PrewarmBlock *first = &prewarm_blocks[prewarm_pos];
+			int64		end = prewarm_pos;
+
+			/* Blocks of other databases can't be mapped to relations */
+			while (end < prewarm_nblocks &&
+				   prewarm_blocks[end].database == first->database &&
+				   prewarm_blocks[end].tablespace == first->tablespace &&
+				   prewarm_blocks[end].filenumber == first->filenumber)
+				end++;
+			if (first->database != MyDatabaseId && first->database != InvalidOid)
+			{
+				prewarm_pos = end;
+				continue;
+			}
+
+			if (!prewarm_relation(end, deadline))
+				break;
+			if (deadline != 0 && GetCurrentTimestamp() >= deadline)
+				break;
+		}
+
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Prewarm failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+
+		/* Don't trip over the same block again */
+		prewarm_pos = prewarm_nblocks;
+		return -1;
+	}
+	PG_END_TRY();
+
+	if (prewarm_pos >= prewarm_nblocks)
+	{
+		host_free(prewarm_blocks);
+		prewarm_blocks = NULL;
+		prewarm_nblocks = prewarm_pos = 0;
+	}
+
+	return prewarm_nblocks - prewarm_pos;
+}
+
+/*
+ * pg_embedded_prewarm_dump
+ *
+ * Save the current buffer list now, e.g. periodically so that a crash
+ * doesn't lose it.
+ */
+int64_t
+pg_embedded_prewarm_dump(void)
+{
+	int64		n;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	/* On failure, autoprewarm_dump() has set pg_error_msg */
+	n = autoprewarm_dump();
+
+	return n;
+}
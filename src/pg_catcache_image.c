@@ -0,0 +1,368 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_catcache_image.c
+ *	  Catalog cache image for fast warm starts of the Embedded API
+ *
+ * PostgreSQL's relcache init file only covers the critical system
+ * relations; everything else a workload needs is looked up again, one
+ * index probe at a time, by the first queries after a restart.  With
+ * pg_embedded_config.catcache_image, the keys of all catcache entries and
+ * the OIDs of all relcache entries are saved to the data directory at
+ * shutdown, and looked up again at startup, so the caches are already warm
+ * when the first query arrives.
+ *
+ * Only keys are saved, never cache contents: every entry is rebuilt from
+ * the catalogs as they are now, so a stale image can't produce stale
+ * entries.  The image is still tied to the catalog version, system
+ * identifier and database; if any of those differ it is ignored.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_catcache_image.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/relation.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "catalog/catversion.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/catcache.h"
+#include "utils/rel.h"
+#include "utils/relcache.h"
+#include "utils/syscache.h"
+
+/* Added by patches to relcache.c and syscache.c */
+extern List *RelationCacheGetRelids(void);
+extern CatCache *SysCacheGetCache(int cacheId);
+
+/* Relative to the data directory, which is the working directory */
+#define CATCACHE_IMAGE_FILE		"pg_embedded_catcache"
+#define CATCACHE_IMAGE_MAGIC	0x50474343	/* "PGCC" */
+#define CATCACHE_IMAGE_VERSION	1
+
+typedef struct CatCacheImageHeader
+{
+	uint32		magic;
+	uint32		version;
+	uint32		catversion;
+	Oid			database;
+	uint64		system_identifier;
+	uint32		ncaches;		/* SysCacheSize when written */
+	uint32		nrelids;
+	uint64		nentries;
+} CatCacheImageHeader;
+
+/*
+ * An entry is written as its cache ID and key count followed by the keys:
+ * by-value keys as a Datum, by-reference keys as their length and bytes.
+ */
+typedef struct CatCacheImageEntry
+{
+	int16		cacheid;
+	int16		nkeys;
+} CatCacheImageEntry;
+
+/*
+ * write_entry_keys
+ *
+ * Write one cache entry.  Returns false if the file can't be written.
+ */
+static bool
+write_entry_keys(FILE *file, CatCache *cache, CatCTup *ct)
+{
+	CatCacheImageEntry entry;
+	int			i;
+
+	entry.cacheid = cache->id;
+	entry.nkeys = cache->cc_nkeys;
+	if (fwrite(&entry, sizeof(entry), 1, file) != 1)
+		return false;
+
+	for (i = 0; i < cache->cc_nkeys; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(cache->cc_tupdesc,
+											   cache->cc_keyno[i] - 1);
+		Datum		key = ct->keys[i];
+
+		if (attr->attbyval)
+		{
+			if (fwrite(&key, sizeof(Datum), 1, file) != 1)
+				return false;
+		}
+		else
+		{
+			uint32		len = attr->attlen > 0 ? attr->attlen :
+				VARSIZE_ANY(DatumGetPointer(key));
+
+			if (fwrite(&len, sizeof(len), 1, file) != 1 ||
+				fwrite(DatumGetPointer(key), 1, len, file) != len)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * catcache_image_save
+ *
+ * Write the image.  Called at shutdown while the caches are still there.
+ * Returns 0 on success, -1 on failure.
+ */
+int
+catcache_image_save(void)
+{
+	CatCacheImageHeader header;
+	List	   *relids;
+	ListCell   *lc;
+	FILE	   *file;
+	int			cacheid;
+	bool		ok = true;
+
+	file = AllocateFile(CATCACHE_IMAGE_FILE ".tmp", PG_BINARY_W);
+	if (!file)
+		return -1;
+
+	relids = RelationCacheGetRelids();
+
+	memset(&header, 0, sizeof(header));
+	header.magic = CATCACHE_IMAGE_MAGIC;
+	header.version = CATCACHE_IMAGE_VERSION;
+	header.catversion = CATALOG_VERSION_NO;
+	header.database = MyDatabaseId;
+	header.system_identifier = GetSystemIdentifier();
+	header.ncaches = SysCacheSize;
+	header.nrelids = list_length(relids);
+
+	/* Count the entries first, so loading knows when to stop */
+	for (cacheid = 0; cacheid < SysCacheSize; cacheid++)
+	{
+		CatCache   *cache = SysCacheGetCache(cacheid);
+		int			i;
+
+		if (cache == NULL || cache->cc_tupdesc == NULL)
+			continue;
+		for (i = 0; i < cache->cc_nbuckets; i++)
+		{
+			dlist_iter	iter;
+
+			dlist_foreach(iter, &cache->cc_bucket[i])
+			{
+				if (!dlist_container(CatCTup, cache_elem, iter.cur)->dead)
+					header.nentries++;
+			}
+		}
+	}
+
+	ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	foreach(lc, relids)
+	{
+		Oid			relid = lfirst_oid(lc);
+
+		if (ok)
+			ok = fwrite(&relid, sizeof(Oid), 1, file) == 1;
+	}
+
+	for (cacheid = 0; ok && cacheid < SysCacheSize; cacheid++)
+	{
+		CatCache   *cache = SysCacheGetCache(cacheid);
+		int			i;
+
+		if (cache == NULL || cache->cc_tupdesc == NULL)
+			continue;
+		for (i = 0; ok && i < cache->cc_nbuckets; i++)
+		{
+			dlist_iter	iter;
+
+			dlist_foreach(iter, &cache->cc_bucket[i])
+			{
+				CatCTup    *ct = dlist_container(CatCTup, cache_elem, iter.cur);
+
+				if (ct->dead)
+					continue;
+				if (!(ok = write_entry_keys(file, cache, ct)))
+					break;
+			}
+		}
+	}
+
+	list_free(relids);
+
+	if (FreeFile(file) != 0 || !ok ||
+		rename(CATCACHE_IMAGE_FILE ".tmp", CATCACHE_IMAGE_FILE) != 0)
+	{
+		unlink(CATCACHE_IMAGE_FILE ".tmp");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * read_entry_keys
+ *
+ * Read the keys of one entry into palloc'd memory.  Returns false at a
+ * malformed entry.
+ */
+static bool
+read_entry_keys(FILE *file, CatCache *cache, int nkeys, Datum *keys)
+{
+	int			i;
+
+	for (i = 0; i < nkeys; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(cache->cc_tupdesc,
+											   cache->cc_keyno[i] - 1);
+
+		if (attr->attbyval)
+		{
+			if (fread(&keys[i], sizeof(Datum), 1, file) != 1)
+				return false;
+		}
+		else
+		{
+			uint32		len;
+			char	   *data;
+
+			if (fread(&len, sizeof(len), 1, file) != 1 || len > BLCKSZ ||
+				(attr->attlen > 0 && len != attr->attlen))
+				return false;
+			data = palloc(len);
+			if (fread(data, 1, len, file) != len)
+				return false;
+			keys[i] = PointerGetDatum(data);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * load_image
+ *
+ * Look up everything in an open image file, inside a transaction.
+ */
+static void
+load_image(FILE *file, const CatCacheImageHeader *header)
+{
+	MemoryContext cxt;
+	MemoryContext keycxt;
+	MemoryContext oldcxt;
+	Oid		   *relids;
+	uint64		n;
+	uint32		i;
+
+	cxt = AllocSetContextCreate(CurrentMemoryContext, "catcache image",
+								ALLOCSET_DEFAULT_SIZES);
+	keycxt = AllocSetContextCreate(cxt, "catcache image keys",
+								   ALLOCSET_SMALL_SIZES);
+	oldcxt = MemoryContextSwitchTo(cxt);
+
+	relids = palloc(Max(header->nrelids, 1) * sizeof(Oid));
+	if (fread(relids, sizeof(Oid), header->nrelids, file) != header->nrelids)
+		goto done;
+
+	/* Catcache entries first: building relcache entries uses them */
+	MemoryContextSwitchTo(keycxt);
+	for (n = 0; n < header->nentries; n++)
+	{
+		CatCacheImageEntry entry;
+		CatCache   *cache;
+		Datum		keys[CATCACHE_MAXKEYS] = {0};
+		HeapTuple	tuple;
+
+		if (fread(&entry, sizeof(entry), 1, file) != 1 ||
+			entry.cacheid < 0 || entry.cacheid >= SysCacheSize)
+			break;
+
+		/* The cache must be set up before its key types are known */
+		cache = SysCacheGetCache(entry.cacheid);
+		if (cache == NULL)
+			break;
+		if (cache->cc_tupdesc == NULL)
+			InitCatCachePhase2(cache, false);
+		if (entry.nkeys != cache->cc_nkeys ||
+			!read_entry_keys(file, cache, entry.nkeys, keys))
+			break;
+
+		/* Negative entries come back as negative entries */
+		tuple = SearchSysCache(entry.cacheid, keys[0], keys[1], keys[2], keys[3]);
+		if (HeapTupleIsValid(tuple))
+			ReleaseSysCache(tuple);
+
+		MemoryContextReset(keycxt);
+	}
+	MemoryContextSwitchTo(cxt);
+
+	for (i = 0; i < header->nrelids; i++)
+	{
+		Relation	rel = try_relation_open(relids[i], AccessShareLock);
+
+		if (rel == NULL)
+			continue;
+		/* The planner wants the index list of every table it sees */
+		if (rel->rd_rel->relhasindex)
+			list_free(RelationGetIndexList(rel));
+		relation_close(rel, AccessShareLock);
+	}
+
+done:
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(cxt);
+}
+
+/*
+ * catcache_image_load
+ *
+ * Warm the caches from the image saved by the last shutdown, if there is a
+ * usable one.  Any problem just leaves the caches cold.
+ */
+void
+catcache_image_load(void)
+{
+	PG_TRY();
+	{
+		CatCacheImageHeader header;
+		FILE	   *file;
+
+		/* Files from AllocateFile are closed when the transaction ends */
+		StartTransactionCommand();
+		file = AllocateFile(CATCACHE_IMAGE_FILE, PG_BINARY_R);
+		if (file)
+		{
+			if (fread(&header, sizeof(header), 1, file) == 1 &&
+				header.magic == CATCACHE_IMAGE_MAGIC &&
+				header.version == CATCACHE_IMAGE_VERSION &&
+				header.catversion == CATALOG_VERSION_NO &&
+				header.database == MyDatabaseId &&
+				header.system_identifier == GetSystemIdentifier() &&
+				header.ncaches == SysCacheSize)
+				load_image(file, &header);
+			FreeFile(file);
+		}
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		fprintf(stderr, "[WARN] Catalog cache image not loaded: %s\n",
+				edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+	}
+	PG_END_TRY();
+}
@@ -0,0 +1,652 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_cdc.c
+ *	  In-process change data capture for the PostgreSQL Embedded API
+ *
+ * Changes are read from the WAL with logical decoding, entirely inside the
+ * embedding process.  The output plugin is compiled into the library and
+ * registered through the static extension registry under the name
+ * PG_CDC_PLUGIN_NAME, so LoadOutputPlugin() finds it the same way it would
+ * find a shared library in a regular server.
+ *
+ * Instead of serializing changes into a text or binary stream, the plugin
+ * deforms each decoded tuple and hands the column values straight to a host
+ * callback.  Logical decoding only emits a transaction once its commit
+ * record has been read, so everything the callback sees is committed.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_cdc.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <string.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/detoast.h"
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlogutils.h"
+#include "catalog/pg_type.h"
+#include "replication/decode.h"
+#include "replication/logical.h"
+#include "replication/output_plugin.h"
+#include "replication/slot.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/*
+ * State of the pg_embedded_cdc_poll() call currently decoding.  The output
+ * plugin callbacks pick it up in their startup callback.
+ */
+typedef struct CdcDecodingState
+{
+	pg_cdc_callback callback;
+	void	   *arg;
+	bool		stopped;		/* callback asked us to stop */
+	bool		skip_txn;		/* don't deliver the current transaction */
+	int64		delivered;		/* number of transactions fully delivered */
+	XLogRecPtr	confirmed_upto; /* end of the last fully delivered commit */
+	MemoryContext change_cxt;	/* reset after every delivered event */
+} CdcDecodingState;
+
+static CdcDecodingState *cdc_state = NULL;
+
+static void cdc_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+						bool is_init);
+static void cdc_begin(LogicalDecodingContext *ctx, ReorderBufferTXN *txn);
+static void cdc_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					   Relation relation, ReorderBufferChange *change);
+static void cdc_truncate(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+						 int nrelations, Relation relations[],
+						 ReorderBufferChange *change);
+static void cdc_commit(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					   XLogRecPtr commit_lsn);
+
+/*
+ * cdc_output_plugin_init
+ *
+ * Output plugin entry point, looked up as "_PG_output_plugin_init" in the
+ * static library PG_CDC_PLUGIN_NAME.
+ */
+static void
+cdc_output_plugin_init(OutputPluginCallbacks *cb)
+{
+	cb->startup_cb = cdc_startup;
+	cb->begin_cb = cdc_begin;
+	cb->change_cb = cdc_change;
+	cb->truncate_cb = cdc_truncate;
+	cb->commit_cb = cdc_commit;
+}
+
+static const StaticExtensionFunc cdc_plugin_functions[] = {
+	{"_PG_output_plugin_init", (PGFunction) cdc_output_plugin_init},
+	{NULL, NULL}
+};
+
+/*
+ * register_cdc_output_plugin
+ *
+ * Make the built-in output plugin visible to LoadOutputPlugin().  The
+ * registry lives in malloc'd memory and survives shutdown, so this only
+ * registers once per process.
+ */
+void
+register_cdc_output_plugin(void)
+{
+	static bool registered = false;
+
+	if (registered)
+		return;
+
+	register_static_extension(PG_CDC_PLUGIN_NAME, NULL,
+							  cdc_plugin_functions, NULL, NULL, NULL);
+	registered = true;
+}
+
+static void
+cdc_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+			bool is_init)
+{
+	opt->output_type = OUTPUT_PLUGIN_BINARY_OUTPUT;
+	opt->receive_rewrites = false;
+
+	/* NULL while creating the slot; only pg_embedded_cdc_poll() delivers */
+	ctx->output_plugin_private = cdc_state;
+}
+
+/*
+ * cdc_deliver
+ *
+ * Hand one event to the host and reset the per-event memory afterwards.
+ * The callback runs under decoding's historic snapshot, inside a
+ * subtransaction that decoding rolls back, so it may not call back in.
+ */
+static void
+cdc_deliver(CdcDecodingState *state, pg_cdc_change *event)
+{
+	int			stop;
+
+	exec_forbid_reentry("a CDC callback");
+	stop = state->callback(event, state->arg);
+	exec_forbid_reentry(NULL);
+	if (stop != 0)
+		state->stopped = true;
+
+	MemoryContextReset(state->change_cxt);
+}
+
+static void
+cdc_begin(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	CdcDecodingState *state = ctx->output_plugin_private;
+	pg_cdc_change event;
+
+	if (state == NULL)
+		return;
+
+	/* Once stopped, leave the remaining transactions for the next poll */
+	state->skip_txn = state->stopped;
+	if (state->skip_txn)
+		return;
+
+	memset(&event, 0, sizeof(event));
+	event.op = PG_CDC_BEGIN;
+	event.xid = txn->xid;
+	event.lsn = txn->first_lsn;
+	event.commit_lsn = txn->final_lsn;
+	event.commit_time = txn->xact_time.commit_time;
+
+	cdc_deliver(state, &event);
+}
+
+/*
+ * cdc_deform_tuple
+ *
+ * Deform a decoded heap tuple into an array of pg_cdc_value, one per
+ * attribute of the relation (dropped attributes are reported as NULL).
+ */
+static pg_cdc_value *
+cdc_deform_tuple(TupleDesc tupdesc, HeapTuple tuple)
+{
+	int			natts = tupdesc->natts;
+	Datum	   *values = palloc(natts * sizeof(Datum));
+	bool	   *isnull = palloc(natts * sizeof(bool));
+	pg_cdc_value *out = palloc0(natts * sizeof(pg_cdc_value));
+	int			i;
+
+	heap_deform_tuple(tuple, tupdesc, values, isnull);
+
+	for (i = 0; i < natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		pg_cdc_value *v = &out[i];
+
+		if (isnull[i] || attr->attisdropped)
+		{
+			v->isnull = true;
+			continue;
+		}
+
+		v->datum = (uint64_t) values[i];
+
+		if (attr->attbyval)
+			continue;
+
+		if (attr->attlen == -1)
+		{
+			struct varlena *val = (struct varlena *) DatumGetPointer(values[i]);
+
+			/*
+			 * Unchanged TOASTed columns of an UPDATE are not in the WAL, only
+			 * a pointer into the TOAST table that we can't follow here.
+			 */
+			if (VARATT_IS_EXTERNAL_ONDISK(val))
+			{
+				v->isnull = true;
+				v->unchanged = true;
+				v->datum = 0;
+				continue;
+			}
+
+			val = detoast_attr(val);
+			v->data = VARDATA(val);
+			v->len = VARSIZE(val) - VARHDRSZ;
+		}
+		else if (attr->attlen == -2)
+		{
+			v->data = DatumGetCString(values[i]);
+			v->len = strlen(v->data);
+		}
+		else
+		{
+			v->data = DatumGetPointer(values[i]);
+			/* name is NUL-padded to NAMEDATALEN */
+			if (attr->atttypid == NAMEOID)
+				v->len = strlen(v->data);
+			else
+				v->len = attr->attlen;
+		}
+	}
+
+	pfree(values);
+	pfree(isnull);
+
+	return out;
+}
+
+/*
+ * cdc_describe_relation
+ *
+ * Fill in the relation identity and column metadata of an event.
+ */
+static void
+cdc_describe_relation(pg_cdc_change *event, Relation relation)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	uint32_t   *atttypes;
+	const char **attnames;
+	int			i;
+
+	event->relid = RelationGetRelid(relation);
+	event->nspname = get_namespace_name(RelationGetNamespace(relation));
+	event->relname = RelationGetRelationName(relation);
+	event->natts = tupdesc->natts;
+
+	atttypes = palloc(tupdesc->natts * sizeof(uint32_t));
+	attnames = palloc(tupdesc->natts * sizeof(char *));
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		atttypes[i] = attr->attisdropped ? InvalidOid : attr->atttypid;
+		attnames[i] = attr->attisdropped ? NULL : NameStr(attr->attname);
+	}
+	event->atttypes = atttypes;
+	event->attnames = attnames;
+}
+
+static void
+cdc_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+		   Relation relation, ReorderBufferChange *change)
+{
+	CdcDecodingState *state = ctx->output_plugin_private;
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	pg_cdc_change event;
+	MemoryContext oldcxt;
+
+	if (state == NULL || state->skip_txn || state->stopped)
+		return;
+
+	memset(&event, 0, sizeof(event));
+	switch (change->action)
+	{
+		case REORDER_BUFFER_CHANGE_INSERT:
+			event.op = PG_CDC_INSERT;
+			break;
+		case REORDER_BUFFER_CHANGE_UPDATE:
+			event.op = PG_CDC_UPDATE;
+			break;
+		case REORDER_BUFFER_CHANGE_DELETE:
+			event.op = PG_CDC_DELETE;
+			break;
+		default:
+			return;
+	}
+
+	oldcxt = MemoryContextSwitchTo(state->change_cxt);
+
+	event.xid = txn->xid;
+	event.lsn = change->lsn;
+	event.commit_lsn = txn->final_lsn;
+	event.commit_time = txn->xact_time.commit_time;
+	cdc_describe_relation(&event, relation);
+
+	if (change->data.tp.oldtuple != NULL)
+		event.oldtuple = cdc_deform_tuple(tupdesc, change->data.tp.oldtuple);
+	if (change->data.tp.newtuple != NULL)
+		event.newtuple = cdc_deform_tuple(tupdesc, change->data.tp.newtuple);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	cdc_deliver(state, &event);
+}
+
+static void
+cdc_truncate(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+			 int nrelations, Relation relations[],
+			 ReorderBufferChange *change)
+{
+	CdcDecodingState *state = ctx->output_plugin_private;
+	int			i;
+
+	if (state == NULL)
+		return;
+
+	for (i = 0; i < nrelations && !state->skip_txn && !state->stopped; i++)
+	{
+		pg_cdc_change event;
+		MemoryContext oldcxt;
+
+		memset(&event, 0, sizeof(event));
+		event.op = PG_CDC_TRUNCATE;
+		event.xid = txn->xid;
+		event.lsn = change->lsn;
+		event.commit_lsn = txn->final_lsn;
+		event.commit_time = txn->xact_time.commit_time;
+
+		oldcxt = MemoryContextSwitchTo(state->change_cxt);
+		cdc_describe_relation(&event, relations[i]);
+		MemoryContextSwitchTo(oldcxt);
+
+		cdc_deliver(state, &event);
+	}
+}
+
+static void
+cdc_commit(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+		   XLogRecPtr commit_lsn)
+{
+	CdcDecodingState *state = ctx->output_plugin_private;
+	pg_cdc_change event;
+
+	if (state == NULL || state->skip_txn)
+		return;
+
+	/*
+	 * The callback stopped us in the middle of this transaction.  Don't
+	 * confirm it, so the whole transaction is delivered again next time.
+	 */
+	if (state->stopped)
+	{
+		state->skip_txn = true;
+		return;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.op = PG_CDC_COMMIT;
+	event.xid = txn->xid;
+	event.lsn = commit_lsn;
+	event.commit_lsn = commit_lsn;
+	event.commit_time = txn->xact_time.commit_time;
+
+	cdc_deliver(state, &event);
+
+	state->delivered++;
+	state->confirmed_upto = txn->end_lsn;
+}
+
+/*
+ * pg_embedded_cdc_create_slot
+ *
+ * Create a persistent logical replication slot using the built-in plugin.
+ * Changes committed after this call are retained until consumed.
+ */
+int
+pg_embedded_cdc_create_slot(const char *slot_name)
+{
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (!slot_name || slot_name[0] == '\0')
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Slot name required");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot create a CDC slot inside a transaction");
+		return -1;
+	}
+
+	PG_TRY();
+	{
+		LogicalDecodingContext *ctx;
+
+		StartTransactionCommand();
+
+		CheckLogicalDecodingRequirements();
+
+		/*
+		 * Same sequence as pg_create_logical_replication_slot(): start out
+		 * ephemeral so an error drops the slot again, and only persist it
+		 * once a consistent starting point has been found.
+		 */
+		ReplicationSlotCreate(slot_name, true, RS_EPHEMERAL, false, false, false);
+
+		ctx = CreateInitDecodingContext(PG_CDC_PLUGIN_NAME, NIL,
+										false,
+										InvalidXLogRecPtr,
+										XL_ROUTINE(.page_read = read_local_xlog_page,
+												   .segment_open = wal_segment_open,
+												   .segment_close = wal_segment_close),
+										NULL, NULL, NULL);
+		DecodingContextFindStartpoint(ctx);
+		FreeDecodingContext(ctx);
+
+		ReplicationSlotPersist();
+		ReplicationSlotRelease();
+
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "CDC slot creation failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		if (MyReplicationSlot != NULL)
+			ReplicationSlotRelease();
+		AbortCurrentTransaction();
+		return -1;
+	}
+	PG_END_TRY();
+
+	return 0;
+}
+
+/*
+ * pg_embedded_cdc_drop_slot
+ *
+ * Drop a slot created by pg_embedded_cdc_create_slot, releasing the WAL it
+ * retains.
+ */
+int
+pg_embedded_cdc_drop_slot(const char *slot_name)
+{
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (exec_reentry_forbidden())
+		return -1;
+
+	if (!slot_name || slot_name[0] == '\0')
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Slot name required");
+		return -1;
+	}
+
+	PG_TRY();
+	{
+		bool		implicit_tx = false;
+
+		if (!IsTransactionState())
+		{
+			StartTransactionCommand();
+			implicit_tx = true;
+		}
+
+		ReplicationSlotDrop(slot_name, true);
+
+		if (implicit_tx)
+			CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "CDC slot drop failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+		return -1;
+	}
+	PG_END_TRY();
+
+	return 0;
+}
+
+/*
+ * pg_embedded_cdc_poll
+ *
+ * Decode all WAL committed since the slot's confirmed position and deliver
+ * it to the callback, then move the slot's confirmed position forward and
+ * save it to disk.
+ */
+int64_t
+pg_embedded_cdc_poll(const char *slot_name, pg_cdc_callback callback,
+					 void *arg, uint64_t *confirmed_lsn)
+{
+	CdcDecodingState state;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (!slot_name || !callback)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Slot name and callback are required");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot poll CDC changes inside a transaction");
+		return -1;
+	}
+
+	memset(&state, 0, sizeof(state));
+	state.callback = callback;
+	state.arg = arg;
+	state.confirmed_upto = InvalidXLogRecPtr;
+
+	PG_TRY();
+	{
+		LogicalDecodingContext *ctx;
+		XLogRecPtr	end_of_wal;
+		XLogRecPtr	upto;
+
+		StartTransactionCommand();
+
+		CheckLogicalDecodingRequirements();
+
+		/*
+		 * There is no WAL writer in embedded mode; with synchronous_commit
+		 * off, recent commits may still sit in the WAL buffers where the WAL
+		 * reader can't see them.
+		 */
+		XLogFlush(GetXLogInsertRecPtr());
+		end_of_wal = GetFlushRecPtr(NULL);
+
+		ReplicationSlotAcquire(slot_name, true, true);
+
+		state.change_cxt = AllocSetContextCreate(CurrentMemoryContext,
+												 "CDC change",
+												 ALLOCSET_DEFAULT_SIZES);
+		cdc_state = &state;
+
+		ctx = CreateDecodingContext(InvalidXLogRecPtr, NIL, false,
+									XL_ROUTINE(.page_read = read_local_xlog_page,
+											   .segment_open = wal_segment_open,
+											   .segment_close = wal_segment_close),
+									NULL, NULL, NULL);
+
+		XLogBeginRead(ctx->reader, MyReplicationSlot->data.restart_lsn);
+
+		while (ctx->reader->EndRecPtr < end_of_wal && !state.stopped)
+		{
+			XLogRecord *record;
+			char	   *errm = NULL;
+
+			record = XLogReadRecord(ctx->reader, &errm);
+			if (errm)
+				elog(ERROR, "could not find record for logical decoding: %s",
+					 errm);
+
+			if (record != NULL)
+				LogicalDecodingProcessRecord(ctx, ctx->reader);
+
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		/*
+		 * If we read everything, all of it has been delivered.  Otherwise
+		 * only confirm up to the last transaction the host accepted.
+		 */
+		upto = state.stopped ? state.confirmed_upto : ctx->reader->EndRecPtr;
+		if (upto != InvalidXLogRecPtr)
+		{
+			LogicalConfirmReceivedLocation(upto);
+			ReplicationSlotMarkDirty();
+			ReplicationSlotSave();
+		}
+
+		if (confirmed_lsn)
+			*confirmed_lsn = MyReplicationSlot->data.confirmed_flush;
+
+		FreeDecodingContext(ctx);
+		ReplicationSlotRelease();
+		cdc_state = NULL;
+
+		/* Decoding used historic snapshots; don't keep their catalog entries */
+		InvalidateSystemCaches();
+
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		cdc_state = NULL;
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "CDC poll failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		if (MyReplicationSlot != NULL)
+			ReplicationSlotRelease();
+		AbortCurrentTransaction();
+		return -1;
+	}
+	PG_END_TRY();
+
+	return state.delivered;
+}
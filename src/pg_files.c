@@ -0,0 +1,197 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_files.c
+ *	  File descriptor budget and VFD cache statistics for the embedded API
+ *
+ * fd.c keeps relation segments, WAL and other files open through a cache
+ * of virtual file descriptors, holding at most max_safe_fds kernel
+ * descriptors and closing the least recently used one when it needs
+ * another.  A server sizes that from probing how many descriptors it can
+ * dup(); the embedded backend shares its process with the host, so
+ * fd_budget_apply() sizes it from RLIMIT_NOFILE instead, minus what is
+ * already open and what the host reserves for itself, and capped by
+ * pg_embedded_config.max_files, or by 1000 as max_files_per_process is.
+ * The soft limit is raised towards the hard one when max_files asks for
+ * more than it allows.
+ *
+ * With a schema of thousands of tables the default budget is too small to
+ * keep every segment open, and each access to a closed one costs an
+ * open() and, to make room, a close().  pg_embedded_file_stats() counts
+ * those, from counters patched into fd.c.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_files.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "storage/fd.h"
+
+/* From fd.c */
+#define NUM_RESERVED_FDS	10
+#define FD_MINFREE			48
+
+/* Left to the host when pg_embedded_config.reserved_fds is 0 */
+#define DEFAULT_RESERVED_FDS	32
+
+/*
+ * Budget when pg_embedded_config.max_files is 0, as max_files_per_process,
+ * and the most it may ask for.  fd.c sizes its array of allocated
+ * descriptors from max_safe_fds, so it can't just be the limit, which may
+ * be a million or unlimited.
+ */
+#define DEFAULT_MAX_FILES		1000
+#define MAX_FILES_CEILING		65536
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/* Added to fd.c by patches/pg18 */
+extern void GetVfdCacheStats(uint64 *hits, uint64 *misses, uint64 *evictions,
+							 int *open_files, int *vfds);
+
+static int	fd_limit = 0;		/* RLIMIT_NOFILE soft limit, as applied */
+static int	fd_reserved = 0;
+
+/* Descriptors open in this process right now, or -1 if unknown */
+static int
+count_open_fds(void)
+{
+	DIR		   *dir = opendir("/proc/self/fd");
+	struct dirent *de;
+	int			count = 0;
+
+	if (!dir)
+		return -1;
+
+	while ((de = readdir(dir)) != NULL)
+	{
+		if (de->d_name[0] != '.')
+			count++;
+	}
+	closedir(dir);
+
+	/* Don't count the descriptor of the directory itself */
+	return count - 1;
+}
+
+/*
+ * fd_budget_apply
+ *
+ * Set max_safe_fds, in place of set_max_safe_fds().  max_files is the
+ * most the VFD cache may hold open (0: a default), reserved the
+ * descriptors to leave to the host (0: a default).
+ */
+void
+fd_budget_apply(int max_files, int reserved)
+{
+	struct rlimit rlim;
+	int			in_use;
+	int			budget;
+	int			cap;
+
+	if (reserved <= 0)
+		reserved = DEFAULT_RESERVED_FDS;
+	cap = max_files > 0 ? Min(max_files, MAX_FILES_CEILING) : DEFAULT_MAX_FILES;
+
+	in_use = count_open_fds();
+	if (in_use < 0)
+		in_use = 3;				/* stdin, stdout and stderr */
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim) != 0)
+	{
+		rlim.rlim_cur = 1024;
+		rlim.rlim_max = 1024;
+	}
+
+	/* Raise the soft limit as far as max_files needs it */
+	if (max_files > 0 && rlim.rlim_cur != RLIM_INFINITY)
+	{
+		rlim_t		wanted = (rlim_t) cap + NUM_RESERVED_FDS + in_use + reserved;
+
+		if (wanted > rlim.rlim_cur)
+		{
+			struct rlimit raised = rlim;
+
+			raised.rlim_cur = (rlim.rlim_max == RLIM_INFINITY || wanted < rlim.rlim_max) ?
+				wanted : rlim.rlim_max;
+			if (setrlimit(RLIMIT_NOFILE, &raised) == 0)
+				rlim = raised;
+			else
+				elog(LOG, "could not raise the open file limit to %lu: %m",
+					 (unsigned long) raised.rlim_cur);
+		}
+	}
+
+	if (rlim.rlim_cur == RLIM_INFINITY || rlim.rlim_cur > INT_MAX)
+		fd_limit = INT_MAX;
+	else
+		fd_limit = (int) rlim.rlim_cur;
+	fd_reserved = reserved;
+
+	/* No limit, or one beyond the cap, counts as the cap */
+	if (rlim.rlim_cur == RLIM_INFINITY ||
+		rlim.rlim_cur > (rlim_t) cap + NUM_RESERVED_FDS + in_use + reserved)
+		budget = cap;
+	else
+		budget = fd_limit - in_use - reserved - NUM_RESERVED_FDS;
+
+	if (budget < FD_MINFREE)
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("insufficient file descriptors available to start server process"),
+				 errdetail("System allows %d, %d are open and %d are reserved for the host, but at least %d are needed.",
+						   fd_limit, in_use, reserved,
+						   FD_MINFREE + NUM_RESERVED_FDS),
+				 errhint("Raise the open file limit (ulimit -n) or lower reserved_fds.")));
+
+	max_safe_fds = budget;
+	elog(DEBUG2, "max_safe_fds = %d, open file limit = %d, already open = %d, reserved = %d",
+		 max_safe_fds, fd_limit, in_use, reserved);
+}
+
+/*
+ * pg_embedded_file_stats
+ */
+int
+pg_embedded_file_stats(pg_file_stats *out)
+{
+	uint64		hits;
+	uint64		misses;
+	uint64		evictions;
+
+	if (!out)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "NULL argument");
+		return -1;
+	}
+	memset(out, 0, sizeof(pg_file_stats));
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	GetVfdCacheStats(&hits, &misses, &evictions,
+					 &out->open_files, &out->vfds);
+	out->fd_limit = fd_limit;
+	out->reserved_fds = fd_reserved;
+	out->max_safe_fds = max_safe_fds;
+	out->hits = hits;
+	out->misses = misses;
+	out->evictions = evictions;
+	return 0;
+}
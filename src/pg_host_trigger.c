@@ -0,0 +1,344 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_host_trigger.c
+ *	  Host C callbacks as trigger functions for the PostgreSQL Embedded API
+ *
+ * A single C-language trigger function, pg_embedded_host_trigger, lives in
+ * the static library PG_HOST_TRIGGER_LIBRARY.  It dispatches to a host
+ * callback registered with pg_embedded_register_trigger(), selected by the
+ * trigger's first argument (or the trigger's name if it has none), and
+ * passes the OLD/NEW rows as deformed Datum arrays.
+ *
+ * Statement-level triggers with transition tables deliver the whole batch
+ * in one call, so a bulk INSERT costs one callback instead of one per row.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_host_trigger.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/htup_details.h"
+#include "commands/trigger.h"
+#include "executor/executor.h"
+#include "executor/tuptable.h"
+#include "fmgr.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/tuplestore.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+typedef struct HostTrigger
+{
+	struct HostTrigger *next;
+	char	   *name;
+	pg_trigger_callback callback;
+	void	   *arg;
+} HostTrigger;
+
+static HostTrigger *host_triggers = NULL;
+
+/* Deformed rows of one side (OLD or NEW) of an event */
+typedef struct TriggerRows
+{
+	uint64_t   *values;
+	bool	   *isnull;
+} TriggerRows;
+
+PG_FUNCTION_INFO_V1(pg_embedded_host_trigger);
+
+static const StaticExtensionFunc host_trigger_functions[] = {
+	{"pg_embedded_host_trigger", pg_embedded_host_trigger},
+	{NULL, NULL}
+};
+
+static const StaticExtensionFInfo host_trigger_finfo[] = {
+	{"pg_finfo_pg_embedded_host_trigger", pg_finfo_pg_embedded_host_trigger},
+	{NULL, NULL}
+};
+
+/*
+ * register_host_trigger_library
+ *
+ * Make pg_embedded_host_trigger loadable by CREATE FUNCTION ... LANGUAGE C.
+ */
+void
+register_host_trigger_library(void)
+{
+	static bool registered = false;
+
+	if (registered)
+		return;
+
+	register_static_extension(PG_HOST_TRIGGER_LIBRARY, NULL,
+							  host_trigger_functions, host_trigger_finfo,
+							  NULL, NULL);
+	registered = true;
+}
+
+static HostTrigger *
+lookup_host_trigger(const char *name)
+{
+	HostTrigger *trig;
+
+	for (trig = host_triggers; trig != NULL; trig = trig->next)
+	{
+		if (strcmp(trig->name, name) == 0)
+			return trig;
+	}
+
+	return NULL;
+}
+
+/*
+ * pg_embedded_register_trigger
+ *
+ * Register (or replace) the host callback behind a trigger name.
+ */
+int
+pg_embedded_register_trigger(const char *name, pg_trigger_callback callback,
+							 void *arg)
+{
+	HostTrigger *trig;
+
+	if (!name || name[0] == '\0' || !callback)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Trigger name and callback are required");
+		return -1;
+	}
+
+	trig = lookup_host_trigger(name);
+	if (trig == NULL)
+	{
+		trig = (HostTrigger *) host_malloc(sizeof(HostTrigger));
+		if (!trig)
+		{
+			snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+			return -1;
+		}
+		trig->name = host_strdup(name);
+		if (!trig->name)
+		{
+			host_free(trig);
+			snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+			return -1;
+		}
+		trig->next = host_triggers;
+		host_triggers = trig;
+	}
+
+	trig->callback = callback;
+	trig->arg = arg;
+
+	return 0;
+}
+
+/*
+ * deform_row
+ *
+ * Deform one tuple into row "row" of a TriggerRows batch.
+ */
+static void
+deform_row(TupleDesc tupdesc, HeapTuple tuple, TriggerRows *rows, uint64 row)
+{
+	int			natts = tupdesc->natts;
+	Datum	   *values = palloc(natts * sizeof(Datum));
+	int			i;
+
+	heap_deform_tuple(tuple, tupdesc, values, rows->isnull + row * natts);
+
+	for (i = 0; i < natts; i++)
+		rows->values[row * natts + i] = (uint64_t) values[i];
+
+	pfree(values);
+}
+
+/*
+ * deform_transition_table
+ *
+ * Deform all rows of a transition table.  The tuples are copied so the
+ * by-reference Datums stay valid until the whole batch is delivered.
+ */
+static uint64
+deform_transition_table(TupleDesc tupdesc, Tuplestorestate *tstore,
+						TriggerRows *rows)
+{
+	TupleTableSlot *slot;
+	uint64		nrows = (uint64) tuplestore_tuple_count(tstore);
+	uint64		row = 0;
+	int			readptr;
+
+	rows->values = palloc(Max(nrows, 1) * tupdesc->natts * sizeof(uint64_t));
+	rows->isnull = palloc(Max(nrows, 1) * tupdesc->natts * sizeof(bool));
+
+	/* Use our own read pointer, as NamedTuplestoreScan does */
+	readptr = tuplestore_alloc_read_pointer(tstore, EXEC_FLAG_REWIND);
+	tuplestore_select_read_pointer(tstore, readptr);
+	tuplestore_rescan(tstore);
+
+	slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsMinimalTuple);
+	while (row < nrows && tuplestore_gettupleslot(tstore, true, false, slot))
+	{
+		HeapTuple	tuple = ExecCopySlotHeapTuple(slot);
+
+		deform_row(tupdesc, tuple, rows, row);
+		row++;
+	}
+	ExecDropSingleTupleTableSlot(slot);
+
+	return row;
+}
+
+/*
+ * pg_embedded_host_trigger
+ *
+ * The trigger function behind every host trigger.
+ */
+Datum
+pg_embedded_host_trigger(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	TriggerEvent tg_event;
+	TupleDesc	tupdesc;
+	HostTrigger *trig;
+	const char *name;
+	pg_trigger_event event;
+	TriggerRows oldrows = {0};
+	TriggerRows newrows = {0};
+	uint32_t   *atttypes;
+	MemoryContext cxt;
+	MemoryContext oldcxt;
+	int			i;
+	int			ret;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("pg_embedded_host_trigger: not called by trigger manager")));
+
+	tg_event = trigdata->tg_event;
+	name = trigdata->tg_trigger->tgnargs > 0 ?
+		trigdata->tg_trigger->tgargs[0] : trigdata->tg_trigger->tgname;
+
+	/* Cache the lookup; the FmgrInfo belongs to this trigger */
+	trig = (HostTrigger *) fcinfo->flinfo->fn_extra;
+	if (trig == NULL)
+	{
+		trig = lookup_host_trigger(name);
+		if (trig == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_FUNCTION),
+					 errmsg("no host trigger callback registered as \"%s\"", name),
+					 errhint("Register it with pg_embedded_register_trigger().")));
+		fcinfo->flinfo->fn_extra = trig;
+	}
+
+	cxt = AllocSetContextCreate(CurrentMemoryContext, "host trigger",
+								ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(cxt);
+
+	tupdesc = RelationGetDescr(trigdata->tg_relation);
+
+	memset(&event, 0, sizeof(event));
+	event.relid = RelationGetRelid(trigdata->tg_relation);
+	event.trigger_name = trigdata->tg_trigger->tgname;
+	event.before = TRIGGER_FIRED_BEFORE(tg_event);
+	event.per_statement = TRIGGER_FIRED_FOR_STATEMENT(tg_event);
+	event.natts = tupdesc->natts;
+
+	atttypes = palloc(tupdesc->natts * sizeof(uint32_t));
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		atttypes[i] = attr->attisdropped ? InvalidOid : attr->atttypid;
+	}
+	event.atttypes = atttypes;
+
+	if (TRIGGER_FIRED_BY_INSERT(tg_event))
+		event.op = PG_TRIGGER_INSERT;
+	else if (TRIGGER_FIRED_BY_UPDATE(tg_event))
+		event.op = PG_TRIGGER_UPDATE;
+	else if (TRIGGER_FIRED_BY_DELETE(tg_event))
+		event.op = PG_TRIGGER_DELETE;
+	else
+		event.op = PG_TRIGGER_TRUNCATE;
+
+	if (TRIGGER_FIRED_FOR_ROW(tg_event))
+	{
+		HeapTuple	oldtuple = NULL;
+		HeapTuple	newtuple = NULL;
+
+		if (event.op == PG_TRIGGER_INSERT)
+			newtuple = trigdata->tg_trigtuple;
+		else if (event.op == PG_TRIGGER_UPDATE)
+		{
+			oldtuple = trigdata->tg_trigtuple;
+			newtuple = trigdata->tg_newtuple;
+		}
+		else
+			oldtuple = trigdata->tg_trigtuple;
+
+		event.nrows = 1;
+		if (oldtuple)
+		{
+			oldrows.values = palloc(tupdesc->natts * sizeof(uint64_t));
+			oldrows.isnull = palloc(tupdesc->natts * sizeof(bool));
+			deform_row(tupdesc, oldtuple, &oldrows, 0);
+		}
+		if (newtuple)
+		{
+			newrows.values = palloc(tupdesc->natts * sizeof(uint64_t));
+			newrows.isnull = palloc(tupdesc->natts * sizeof(bool));
+			deform_row(tupdesc, newtuple, &newrows, 0);
+		}
+	}
+	else
+	{
+		/* Without REFERENCING ... TABLE there are no rows to pass */
+		if (trigdata->tg_oldtable)
+			event.nrows = deform_transition_table(tupdesc, trigdata->tg_oldtable,
+												  &oldrows);
+		if (trigdata->tg_newtable)
+			event.nrows = deform_transition_table(tupdesc, trigdata->tg_newtable,
+												  &newrows);
+	}
+
+	event.old_values = oldrows.values;
+	event.old_isnull = oldrows.isnull;
+	event.new_values = newrows.values;
+	event.new_isnull = newrows.isnull;
+
+	ret = trig->callback(&event, trig->arg);
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(cxt);
+
+	if (ret != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_TRIGGERED_ACTION_EXCEPTION),
+				 errmsg("host trigger callback \"%s\" failed with code %d",
+						trig->name, ret)));
+
+	/* BEFORE ROW triggers must hand the row back to keep the change */
+	if (TRIGGER_FIRED_FOR_ROW(tg_event) && TRIGGER_FIRED_BEFORE(tg_event))
+	{
+		if (event.op == PG_TRIGGER_UPDATE)
+			return PointerGetDatum(trigdata->tg_newtuple);
+		return PointerGetDatum(trigdata->tg_trigtuple);
+	}
+
+	return PointerGetDatum(NULL);
+}
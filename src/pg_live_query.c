@@ -0,0 +1,615 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_live_query.c
+ *	  Live queries for the PostgreSQL Embedded API
+ *
+ * A live query keeps its SPI plan, the relations the plan depends on (the
+ * CachedPlanSource's relationOids, which include the tables behind views)
+ * and the pg_relmod counters of those relations as of its last run.
+ * pg_embedded_live_refresh() re-executes only the queries whose counters
+ * moved, diffs the new rows against the previous result and pushes the
+ * difference to the host.
+ *
+ * Only changes to relations the planner sees are tracked: tables read from
+ * inside functions, or results depending on volatile functions such as
+ * now(), are not a reason to re-run a query.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_live_query.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+#include "pg_relmod.h"
+
+#include "access/xact.h"
+#include "executor/spi.h"
+#include "lib/stringinfo.h"
+#include "utils/memutils.h"
+#include "utils/plancache.h"
+#include "utils/snapmgr.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/* Outcome of one re-execution, delivered after the transaction commits */
+typedef struct LiveRun
+{
+	pg_result  *result;
+	pg_result  *added;
+	pg_result  *removed;
+	uint64		epoch;
+	int			ndeps;
+	Oid		   *dep_relids;
+	uint64	   *dep_counts;
+} LiveRun;
+
+typedef struct LiveQuery
+{
+	struct LiveQuery *next;
+	int			id;
+	char	   *sql;
+	pg_live_query_callback callback;
+	void	   *arg;
+	SPIPlanPtr	plan;			/* kept plan, NULL until (re)prepared */
+	bool		has_run;		/* false forces the next refresh to run it */
+	uint64		epoch;			/* pg_relmod_epoch() at the last run */
+	int			ndeps;
+	Oid		   *dep_relids;
+	uint64	   *dep_counts;
+	pg_result  *last;			/* rows delivered so far */
+	LiveRun		run;			/* pending delivery */
+} LiveQuery;
+
+static LiveQuery *live_queries = NULL;
+static int	next_live_query_id = 0;
+
+/* A row of a result, with the key it is compared by */
+typedef struct DiffRow
+{
+	char	   *key;
+	uint64		row;
+} DiffRow;
+
+/*
+ * live_query_reset
+ *
+ * Called on every pg_embedded_init: the kept plans died with the previous
+ * instance's memory.  The subscriptions survive and run again on the next
+ * refresh, diffed against what they delivered before.
+ */
+void
+live_query_reset(void)
+{
+	LiveQuery  *lq;
+
+	for (lq = live_queries; lq != NULL; lq = lq->next)
+	{
+		lq->plan = NULL;
+		lq->has_run = false;
+	}
+}
+
+/*
+ * live_query_release
+ *
+ * Free the kept plans to save memory; they are prepared again on the next
+ * refresh that needs them.
+ */
+void
+live_query_release(void)
+{
+	LiveQuery  *lq;
+
+	for (lq = live_queries; lq != NULL; lq = lq->next)
+	{
+		if (lq->plan != NULL)
+			SPI_freeplan(lq->plan);
+		lq->plan = NULL;
+	}
+}
+
+static void
+live_run_discard(LiveRun *run)
+{
+	pg_embedded_free_result(run->result);
+	pg_embedded_free_result(run->added);
+	pg_embedded_free_result(run->removed);
+	host_free(run->dep_relids);
+	host_free(run->dep_counts);
+	memset(run, 0, sizeof(LiveRun));
+}
+
+/*
+ * live_query_changed
+ *
+ * Has any relation the query depends on been modified since its last run?
+ */
+static bool
+live_query_changed(LiveQuery *lq)
+{
+	int			i;
+
+	if (!lq->has_run || lq->epoch != pg_relmod_epoch())
+		return true;
+
+	for (i = 0; i < lq->ndeps; i++)
+	{
+		if (pg_relmod_count(lq->dep_relids[i]) != lq->dep_counts[i])
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * row_key
+ *
+ * Serialize a row so that equal rows, and only equal rows, get equal keys.
+ */
+static char *
+row_key(const pg_result *result, uint64 row)
+{
+	StringInfoData buf;
+	int			col;
+
+	initStringInfo(&buf);
+	for (col = 0; col < result->cols; col++)
+	{
+		const char *value = result->values[row][col];
+
+		if (value == NULL)
+			appendStringInfoChar(&buf, 'N');
+		else
+			appendStringInfo(&buf, "V%zu:%s", strlen(value), value);
+	}
+
+	return buf.data;
+}
+
+static int
+diff_row_cmp(const void *a, const void *b)
+{
+	return strcmp(((const DiffRow *) a)->key, ((const DiffRow *) b)->key);
+}
+
+static int
+row_index_cmp(const void *a, const void *b)
+{
+	uint64		ra = *(const uint64 *) a;
+	uint64		rb = *(const uint64 *) b;
+
+	return (ra > rb) - (ra < rb);
+}
+
+static DiffRow *
+sorted_rows(const pg_result *result)
+{
+	DiffRow    *rows = palloc(Max(result->rows, 1) * sizeof(DiffRow));
+	uint64		row;
+
+	for (row = 0; row < result->rows; row++)
+	{
+		rows[row].key = row_key(result, row);
+		rows[row].row = row;
+	}
+	qsort(rows, result->rows, sizeof(DiffRow), diff_row_cmp);
+
+	return rows;
+}
+
+/*
+ * subset_result
+ *
+ * Copy the given rows (in result order) of a result into a new pg_result.
+ */
+static pg_result *
+subset_result(const pg_result *src, uint64 *rows, uint64 nrows)
+{
+	pg_result  *result = host_calloc(1, sizeof(pg_result));
+	uint64		i;
+	int			col;
+
+	if (!result)
+		elog(ERROR, "out of memory");
+
+	result->status = src->status;
+	result->cols = src->cols;
+	result->colnames = host_calloc(Max(src->cols, 1), sizeof(char *));
+	result->values = host_calloc(Max(nrows, 1), sizeof(char **));
+	if (!result->colnames || !result->values)
+	{
+		pg_embedded_free_result(result);
+		elog(ERROR, "out of memory");
+	}
+	for (col = 0; col < src->cols; col++)
+		result->colnames[col] = host_strdup(src->colnames[col]);
+
+	qsort(rows, nrows, sizeof(uint64), row_index_cmp);
+	for (i = 0; i < nrows; i++)
+	{
+		result->values[i] = host_calloc(Max(src->cols, 1), sizeof(char *));
+		result->rows = i + 1;
+		if (!result->values[i])
+		{
+			pg_embedded_free_result(result);
+			elog(ERROR, "out of memory");
+		}
+		for (col = 0; col < src->cols; col++)
+		{
+			const char *value = src->values[rows[i]][col];
+
+			result->values[i][col] = value ? host_strdup(value) : NULL;
+		}
+	}
+
+	return result;
+}
+
+/*
+ * diff_results
+ *
+ * Compute the rows added to and removed from "before" (which may be NULL)
+ * to get "after".  Both sides are sorted by row key and merged, so
+ * duplicates are matched one to one.
+ */
+static void
+diff_results(const pg_result *before, const pg_result *after, LiveRun *run)
+{
+	pg_result	empty = {0};
+	DiffRow    *old_rows;
+	DiffRow    *new_rows;
+	uint64	   *added = palloc(Max(after->rows, 1) * sizeof(uint64));
+	uint64	   *removed;
+	uint64		nadded = 0;
+	uint64		nremoved = 0;
+	uint64		i = 0;
+	uint64		j = 0;
+
+	if (before == NULL)
+	{
+		empty.status = after->status;
+		empty.cols = after->cols;
+		empty.colnames = after->colnames;
+		before = &empty;
+	}
+
+	removed = palloc(Max(before->rows, 1) * sizeof(uint64));
+	old_rows = sorted_rows(before);
+	new_rows = sorted_rows(after);
+
+	while (i < before->rows || j < after->rows)
+	{
+		int			cmp;
+
+		if (i >= before->rows)
+			cmp = 1;
+		else if (j >= after->rows)
+			cmp = -1;
+		else
+			cmp = strcmp(old_rows[i].key, new_rows[j].key);
+
+		if (cmp < 0)
+			removed[nremoved++] = old_rows[i++].row;
+		else if (cmp > 0)
+			added[nadded++] = new_rows[j++].row;
+		else
+		{
+			i++;
+			j++;
+		}
+	}
+
+	run->added = subset_result(after, added, nadded);
+	run->removed = subset_result(before, removed, nremoved);
+}
+
+/*
+ * live_query_execute
+ *
+ * Run one live query and prepare its delivery in lq->run.  Must be called
+ * with SPI connected and a snapshot pushed; errors are thrown.
+ */
+static void
+live_query_execute(LiveQuery *lq, MemoryContext tmpcxt)
+{
+	LiveRun    *run = &lq->run;
+	CachedPlanSource *plansource;
+	MemoryContext oldcxt;
+	ListCell   *lc;
+	int			ret;
+	int			i;
+
+	if (lq->plan == NULL)
+	{
+		SPIPlanPtr	plan = SPI_prepare(lq->sql, 0, NULL);
+		List	   *sources;
+
+		if (plan == NULL)
+			elog(ERROR, "could not prepare live query: %s",
+				 SPI_result_code_string(SPI_result));
+
+		sources = SPI_plan_get_plan_sources(plan);
+		if (list_length(sources) != 1 ||
+			((CachedPlanSource *) linitial(sources))->commandTag != CMDTAG_SELECT)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("a live query must be a single SELECT statement")));
+
+		if (SPI_keepplan(plan) != 0)
+			elog(ERROR, "could not keep live query plan");
+		lq->plan = plan;
+	}
+
+	ret = SPI_execute_plan(lq->plan, NULL, NULL, true, 0);
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "live query failed: %s", SPI_result_code_string(ret));
+
+	run->result = host_calloc(1, sizeof(pg_result));
+	if (!run->result)
+		elog(ERROR, "out of memory");
+	run->result->status = ret;
+	run->result->rows = SPI_processed;
+	run->result->cols = SPI_tuptable->tupdesc->natts;
+	if (pg_embedded_copy_tuptable(run->result, SPI_tuptable) != 0)
+		elog(ERROR, "%s", pg_error_msg);
+	SPI_freetuptable(SPI_tuptable);
+
+	/* Read after execution: a replan may have changed the dependencies */
+	plansource = linitial(SPI_plan_get_plan_sources(lq->plan));
+	run->epoch = pg_relmod_epoch();
+	run->ndeps = list_length(plansource->relationOids);
+	run->dep_relids = host_malloc(Max(run->ndeps, 1) * sizeof(Oid));
+	run->dep_counts = host_malloc(Max(run->ndeps, 1) * sizeof(uint64));
+	if (!run->dep_relids || !run->dep_counts)
+		elog(ERROR, "out of memory");
+	i = 0;
+	foreach(lc, plansource->relationOids)
+	{
+		run->dep_relids[i] = lfirst_oid(lc);
+		run->dep_counts[i] = pg_relmod_count(lfirst_oid(lc));
+		i++;
+	}
+
+	oldcxt = MemoryContextSwitchTo(tmpcxt);
+	diff_results(lq->last, run->result, run);
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextReset(tmpcxt);
+}
+
+/*
+ * live_query_deliver
+ *
+ * Make the pending run the query's state and hand the diff to the host.
+ * Nothing is delivered when the rows didn't change.
+ */
+static void
+live_query_deliver(LiveQuery *lq)
+{
+	LiveRun    *run = &lq->run;
+	bool		first = !lq->has_run && lq->last == NULL;
+
+	pg_embedded_free_result(lq->last);
+	host_free(lq->dep_relids);
+	host_free(lq->dep_counts);
+
+	lq->last = run->result;
+	lq->epoch = run->epoch;
+	lq->ndeps = run->ndeps;
+	lq->dep_relids = run->dep_relids;
+	lq->dep_counts = run->dep_counts;
+	lq->has_run = true;
+
+	if (first || run->added->rows > 0 || run->removed->rows > 0)
+		lq->callback(lq->id, run->added, run->removed, lq->arg);
+
+	pg_embedded_free_result(run->added);
+	pg_embedded_free_result(run->removed);
+	memset(run, 0, sizeof(LiveRun));
+}
+
+/*
+ * live_query_run
+ *
+ * Run the given live query, or every changed one if lq is NULL, in a
+ * transaction of its own, and deliver the results after it committed.
+ * Returns the number of queries run, or -1 on error (nothing is delivered
+ * then).
+ */
+static int
+live_query_run(LiveQuery *only)
+{
+	volatile int nrun = 0;
+	LiveQuery  *lq;
+
+	PG_TRY();
+	{
+		MemoryContext tmpcxt;
+
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "SPI_connect failed");
+
+		tmpcxt = AllocSetContextCreate(TopTransactionContext, "live query diff",
+									   ALLOCSET_DEFAULT_SIZES);
+
+		for (lq = live_queries; lq != NULL; lq = lq->next)
+		{
+			if (only != NULL ? lq != only : !live_query_changed(lq))
+				continue;
+			live_query_execute(lq, tmpcxt);
+			nrun++;
+		}
+
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Live query failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+
+		for (lq = live_queries; lq != NULL; lq = lq->next)
+			live_run_discard(&lq->run);
+		return -1;
+	}
+	PG_END_TRY();
+
+	/* Outside the transaction, so callbacks may use the API freely */
+	for (lq = live_queries; lq != NULL; lq = lq->next)
+	{
+		if (lq->run.result != NULL)
+			live_query_deliver(lq);
+	}
+
+	return nrun;
+}
+
+static int
+live_query_check_state(void)
+{
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot run live queries inside a transaction");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+live_query_free(LiveQuery *lq)
+{
+	/* The plan is only freed while its memory is still ours */
+	if (lq->plan != NULL && pg_embedded_is_initialized())
+		SPI_freeplan(lq->plan);
+	live_run_discard(&lq->run);
+	pg_embedded_free_result(lq->last);
+	host_free(lq->dep_relids);
+	host_free(lq->dep_counts);
+	host_free(lq->sql);
+	host_free(lq);
+}
+
+/*
+ * pg_embedded_live_query
+ *
+ * Subscribe to a query and deliver its first result.
+ */
+int
+pg_embedded_live_query(const char *sql, pg_live_query_callback callback,
+					   void *arg)
+{
+	LiveQuery  *lq;
+	LiveQuery **prev;
+
+	if (live_query_check_state() != 0)
+		return -1;
+
+	if (!sql || !callback)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Query and callback are required");
+		return -1;
+	}
+
+	lq = host_calloc(1, sizeof(LiveQuery));
+	if (!lq || !(lq->sql = host_strdup(sql)))
+	{
+		host_free(lq);
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+		return -1;
+	}
+	lq->id = next_live_query_id++;
+	lq->callback = callback;
+	lq->arg = arg;
+
+	/* Append, so that refreshes deliver in subscription order */
+	for (prev = &live_queries; *prev != NULL; prev = &(*prev)->next)
+		;
+	*prev = lq;
+
+	if (live_query_run(lq) < 0)
+	{
+		*prev = NULL;
+		live_query_free(lq);
+		return -1;
+	}
+
+	return lq->id;
+}
+
+/*
+ * pg_embedded_live_query_cancel
+ *
+ * Drop a subscription.
+ */
+int
+pg_embedded_live_query_cancel(int id)
+{
+	LiveQuery **prev;
+
+	for (prev = &live_queries; *prev != NULL; prev = &(*prev)->next)
+	{
+		LiveQuery  *lq = *prev;
+
+		if (lq->id == id)
+		{
+			*prev = lq->next;
+			live_query_free(lq);
+			return 0;
+		}
+	}
+
+	snprintf(pg_error_msg, sizeof(pg_error_msg), "Unknown live query %d", id);
+	return -1;
+}
+
+/*
+ * pg_embedded_live_refresh
+ *
+ * Re-run the live queries whose relations changed and deliver their diffs.
+ */
+int
+pg_embedded_live_refresh(void)
+{
+	LiveQuery  *lq;
+
+	if (live_query_check_state() != 0)
+		return -1;
+
+	/* The common case for an idle database: no catalog or table access */
+	for (lq = live_queries; lq != NULL; lq = lq->next)
+	{
+		if (live_query_changed(lq))
+			break;
+	}
+	if (lq == NULL)
+		return 0;
+
+	return live_query_run(NULL);
+}
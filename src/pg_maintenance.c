@@ -0,0 +1,700 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_maintenance.c
+ *	  Host-driven background maintenance for the PostgreSQL Embedded API
+ *
+ * A standalone backend has none of the auxiliary processes that keep a
+ * server healthy: no WAL writer, no background writer and no checkpointer.
+ * XLogWrite() only requests checkpoints when running under the postmaster,
+ * so WAL piles up until shutdown, which then has to write every dirty
+ * buffer in one go.  pg_embedded_tick() does a slice of their work on the
+ * host's thread whenever the host has time for it.
+ *
+ * There is no autovacuum launcher either; pg_embedded_autovacuum() applies
+ * the autovacuum thresholds to the statistics and vacuums or analyzes the
+ * tables that are due, within a time budget.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_maintenance.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "catalog/pg_class.h"
+#include "commands/vacuum.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "parser/parse_node.h"
+#include "pgstat.h"
+#include "postmaster/autovacuum.h"
+#include "postmaster/bgwriter.h"
+#include "storage/buf_internals.h"
+#include "storage/bufmgr.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+#include "utils/timeout.h"
+#include "utils/timestamp.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/* When the last checkpoint was started by pg_embedded_tick() */
+static pg_time_t last_checkpoint_time = 0;
+
+/* How long that checkpoint took, to guess whether the next one fits */
+static int64 last_checkpoint_us = 0;
+
+/*
+ * A due checkpoint is put off until sweep_dirty_buffers() has written out
+ * what it would have to, over as many ticks as that takes
+ */
+static TimestampTz checkpoint_due_since = 0;
+static int	sweep_next_buf = 0;
+
+/*
+ * checkpoint_due
+ *
+ * The checkpointer's two triggers: checkpoint_timeout has elapsed, or
+ * max_wal_size worth of WAL (CheckPointSegments) was written since the
+ * last checkpoint's redo pointer.  Returns the CHECKPOINT_CAUSE_* flag, or
+ * 0 if no checkpoint is needed yet.
+ */
+static int
+checkpoint_due(void)
+{
+	pg_time_t	now = (pg_time_t) time(NULL);
+	XLogRecPtr	redo = GetRedoRecPtr();
+	XLogRecPtr	insert = GetInsertRecPtr();
+
+	/* The first tick after startup starts the clock */
+	if (last_checkpoint_time == 0)
+		last_checkpoint_time = now;
+
+	if (insert > redo &&
+		insert - redo >= (uint64) CheckPointSegments * wal_segment_size)
+		return CHECKPOINT_CAUSE_XLOG;
+
+	if (now - last_checkpoint_time >= CheckPointTimeout)
+		return CHECKPOINT_CAUSE_TIME;
+
+	return 0;
+}
+
+/*
+ * checkpoint_overdue
+ *
+ * A checkpoint that has waited another checkpoint_timeout, or for twice
+ * max_wal_size of WAL, is run whatever the budget, so a budget too small
+ * for any checkpoint can't hold WAL back forever.
+ */
+static bool
+checkpoint_overdue(TimestampTz now)
+{
+	XLogRecPtr	redo = GetRedoRecPtr();
+	XLogRecPtr	insert = GetInsertRecPtr();
+
+	if (insert > redo &&
+		insert - redo >= 2 * (uint64) CheckPointSegments * wal_segment_size)
+		return true;
+
+	return TimestampDifferenceExceeds(checkpoint_due_since, now,
+									  CheckPointTimeout * 1000);
+}
+
+/*
+ * sweep_dirty_buffers
+ *
+ * Write out dirty permanent buffers, continuing from where the last tick
+ * stopped, until deadline.  SyncOneBuffer() is private to bufmgr.c, so
+ * each buffer is pinned again by its tag with ReadRecentBuffer() and
+ * written with FlushOneBuffer(); a buffer evicted meanwhile is skipped.
+ * Nothing else runs in this process, so the tag read under the header
+ * lock is still the buffer's when it is pinned.  Returns true once every
+ * buffer has been looked at.
+ */
+static bool
+sweep_dirty_buffers(WritebackContext *wb_context, TimestampTz deadline)
+{
+	int			scanned = 0;
+
+	if (sweep_next_buf > NBuffers)
+		sweep_next_buf = NBuffers;
+
+	while (sweep_next_buf < NBuffers)
+	{
+		BufferDesc *bufHdr = GetBufferDescriptor(sweep_next_buf);
+		uint32		buf_state;
+		BufferTag	tag;
+		bool		dirty;
+
+		/* Check the clock every so often, and after each write */
+		if (++scanned % 1024 == 0 && GetCurrentTimestamp() >= deadline)
+			return false;
+
+		sweep_next_buf++;
+
+		buf_state = LockBufHdr(bufHdr);
+		dirty = (buf_state & (BM_VALID | BM_DIRTY | BM_PERMANENT)) ==
+			(BM_VALID | BM_DIRTY | BM_PERMANENT);
+		tag = bufHdr->tag;
+		UnlockBufHdr(bufHdr, buf_state);
+
+		if (!dirty)
+			continue;
+
+		if (ReadRecentBuffer(BufTagGetRelFileLocator(&tag),
+							 BufTagGetForkNum(&tag), tag.blockNum,
+							 BufferDescriptorGetBuffer(bufHdr)))
+		{
+			Buffer		buffer = BufferDescriptorGetBuffer(bufHdr);
+
+			LockBuffer(buffer, BUFFER_LOCK_SHARE);
+			FlushOneBuffer(buffer);
+			UnlockReleaseBuffer(buffer);
+			ScheduleBufferTagForWriteback(wb_context, IOCONTEXT_NORMAL, &tag);
+		}
+
+		if (GetCurrentTimestamp() >= deadline)
+			return sweep_next_buf >= NBuffers;
+	}
+
+	return true;
+}
+
+/*
+ * pg_embedded_tick
+ *
+ * Flush WAL, then either let the background writer clean buffers until
+ * the budget is used up or it has nothing left to do, or, when a
+ * checkpoint is due, write out dirty buffers for it and run it once they
+ * are all written and the budget left looks enough for it.
+ */
+int
+pg_embedded_tick(uint64_t budget_us)
+{
+	volatile int checkpointed = 0;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot run maintenance inside a transaction");
+		return -1;
+	}
+
+	PG_TRY();
+	{
+		TimestampTz deadline;
+		WritebackContext wb_context;
+		int			cause;
+
+		deadline = TimestampTzPlusMicroseconds(GetCurrentTimestamp(),
+											   (int64) budget_us);
+
+		/* Buffer writes need a resource owner */
+		StartTransactionCommand();
+
+		/* WAL writer: get asynchronously committed WAL to disk */
+		XLogBackgroundFlush();
+
+		WritebackContextInit(&wb_context, &bgwriter_flush_after);
+		cause = checkpoint_due();
+		if (cause == 0)
+		{
+			/*
+			 * Background writer: write out dirty buffers that are about to
+			 * be evicted, so neither queries nor the next checkpoint have
+			 * to.
+			 */
+			while (GetCurrentTimestamp() < deadline)
+			{
+				if (BgBufferSync(&wb_context))
+					break;		/* would hibernate: nothing left to do */
+			}
+			IssuePendingWritebacks(&wb_context, IOCONTEXT_NORMAL);
+			pgstat_report_bgwriter();
+		}
+		else
+		{
+			/*
+			 * Checkpointer: a standalone backend performs requested
+			 * checkpoints itself, immediately, writing every dirty buffer
+			 * at once.  Spread that writing over ticks first, so that the
+			 * checkpoint itself is left with little more than the fsyncs.
+			 * Old WAL segments are recycled by the checkpoint.
+			 */
+			TimestampTz now;
+			bool		caught_up;
+
+			if (checkpoint_due_since == 0)
+			{
+				checkpoint_due_since = GetCurrentTimestamp();
+				sweep_next_buf = 0;
+			}
+
+			caught_up = sweep_dirty_buffers(&wb_context, deadline);
+			IssuePendingWritebacks(&wb_context, IOCONTEXT_NORMAL);
+
+			now = GetCurrentTimestamp();
+			if ((caught_up &&
+				 TimestampTzPlusMicroseconds(now, last_checkpoint_us) <= deadline) ||
+				checkpoint_overdue(now))
+			{
+				last_checkpoint_time = (pg_time_t) time(NULL);
+				RequestCheckpoint(cause);
+				last_checkpoint_us = GetCurrentTimestamp() - now;
+				checkpoint_due_since = 0;
+				checkpointed = 1;
+			}
+		}
+
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Maintenance failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+		return -1;
+	}
+	PG_END_TRY();
+
+	return checkpointed;
+}
+
+/*
+ * A table that needs vacuuming or analyzing
+ */
+typedef struct AutoVacTarget
+{
+	Oid			relid;
+	char	   *nspname;
+	char	   *relname;
+	bool		dovacuum;
+	bool		doanalyze;
+	bool		wraparound;
+	double		score;			/* how far past its threshold */
+	BlockNumber relpages;
+} AutoVacTarget;
+
+/*
+ * Vacuum throughput seen so far, used to guess whether a table fits.  Until
+ * a table has been measured, assume the cost-delay throttled rate of
+ * autovacuum's defaults, which is slow.
+ */
+#define DEFAULT_AUTOVAC_US_PER_PAGE	200.0
+static double autovac_us_per_page = 0;
+
+/*
+ * Cancels a VACUUM or ANALYZE that runs past the slice's deadline, through
+ * timeout.c like statement_timeout.  Its SIGALRM handler is only installed
+ * while a slice runs; the host's is back in place otherwise.
+ */
+static TimeoutId autovac_timeout = MAX_TIMEOUTS;
+static struct sigaction timeout_sigalrm;
+
+/*
+ * table_needs_vacanalyze
+ *
+ * The checks of autovacuum.c's relation_needs_vacanalyze(), using the
+ * global autovacuum settings (per-table reloptions are not consulted).
+ */
+static bool
+table_needs_vacanalyze(Form_pg_class classForm, AutoVacTarget *target)
+{
+	PgStat_StatTabEntry *tabentry;
+	TransactionId nextxid = ReadNextTransactionId();
+	float4		reltuples = Max(classForm->reltuples, 0);
+	float4		vacthresh;
+	float4		vacinsthresh;
+	float4		anlthresh;
+	double		score = 0;
+
+	target->wraparound = TransactionIdIsNormal(classForm->relfrozenxid) &&
+		(int32) (nextxid - classForm->relfrozenxid) > autovacuum_freeze_max_age;
+
+	tabentry = pgstat_fetch_stat_tabentry_ext(classForm->relisshared,
+											  classForm->oid);
+	if (tabentry == NULL)
+	{
+		target->dovacuum = target->wraparound;
+		target->doanalyze = false;
+		target->score = target->wraparound ? 1e10 : 0;
+		return target->dovacuum;
+	}
+
+	vacthresh = (float4) autovacuum_vac_thresh + autovacuum_vac_scale * reltuples;
+	if (autovacuum_vac_max_thresh >= 0 && vacthresh > autovacuum_vac_max_thresh)
+		vacthresh = (float4) autovacuum_vac_max_thresh;
+	vacinsthresh = (float4) autovacuum_vac_ins_thresh +
+		autovacuum_vac_ins_scale * reltuples;
+	anlthresh = (float4) autovacuum_anl_thresh + autovacuum_anl_scale * reltuples;
+
+	target->dovacuum = target->wraparound ||
+		tabentry->dead_tuples > vacthresh ||
+		(autovacuum_vac_ins_thresh >= 0 &&
+		 tabentry->ins_since_vacuum > vacinsthresh);
+
+	/* TOAST tables are analyzed along with their main table */
+	target->doanalyze = classForm->relkind != RELKIND_TOASTVALUE &&
+		tabentry->mod_since_analyze > anlthresh;
+
+	if (tabentry->dead_tuples > vacthresh)
+		score = Max(score, tabentry->dead_tuples / Max(vacthresh, 1));
+	if (tabentry->mod_since_analyze > anlthresh)
+		score = Max(score, tabentry->mod_since_analyze / Max(anlthresh, 1));
+	if (target->wraparound)
+		score = 1e10;
+	target->score = score;
+
+	return target->dovacuum || target->doanalyze;
+}
+
+static int
+autovac_target_cmp(const void *a, const void *b)
+{
+	double		sa = ((const AutoVacTarget *) a)->score;
+	double		sb = ((const AutoVacTarget *) b)->score;
+
+	return (sa < sb) - (sa > sb);
+}
+
+/*
+ * collect_autovac_targets
+ *
+ * Scan pg_class for tables, materialized views and TOAST tables that are
+ * due, most urgent first.  Runs in its own transaction; the result is
+ * allocated in cxt.
+ */
+static AutoVacTarget *
+collect_autovac_targets(MemoryContext cxt, int *ntargets)
+{
+	Relation	classRel;
+	TableScanDesc scan;
+	HeapTuple	tuple;
+	AutoVacTarget *targets;
+	int			n = 0;
+	int			size = 64;
+
+	targets = MemoryContextAlloc(cxt, size * sizeof(AutoVacTarget));
+
+	StartTransactionCommand();
+
+	classRel = table_open(RelationRelationId, AccessShareLock);
+	scan = table_beginscan_catalog(classRel, 0, NULL);
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
+		AutoVacTarget target;
+
+		if (classForm->relkind != RELKIND_RELATION &&
+			classForm->relkind != RELKIND_MATVIEW &&
+			classForm->relkind != RELKIND_TOASTVALUE)
+			continue;
+
+		/* Autovacuum leaves temporary tables alone as well */
+		if (classForm->relpersistence == RELPERSISTENCE_TEMP)
+			continue;
+
+		memset(&target, 0, sizeof(target));
+		if (!table_needs_vacanalyze(classForm, &target))
+			continue;
+
+		target.relid = classForm->oid;
+		target.relpages = classForm->relpages;
+		target.nspname = MemoryContextStrdup(cxt,
+											 get_namespace_name(classForm->relnamespace));
+		target.relname = MemoryContextStrdup(cxt, NameStr(classForm->relname));
+
+		if (n == size)
+		{
+			size *= 2;
+			targets = repalloc(targets, size * sizeof(AutoVacTarget));
+		}
+		targets[n++] = target;
+	}
+	table_endscan(scan);
+	table_close(classRel, AccessShareLock);
+
+	CommitTransactionCommand();
+
+	qsort(targets, n, sizeof(AutoVacTarget), autovac_target_cmp);
+	*ntargets = n;
+
+	return targets;
+}
+
+static void
+autovac_timeout_handler(void)
+{
+	QueryCancelPending = true;
+	InterruptPending = true;
+}
+
+/*
+ * maintenance_timeout_init
+ *
+ * Set up timeout.c, before InitPostgres() registers its timeouts, as
+ * PostgresMain() would, but keep the host's SIGALRM disposition.
+ */
+void
+maintenance_timeout_init(void)
+{
+	struct sigaction host_sigalrm;
+
+	sigaction(SIGALRM, NULL, &host_sigalrm);
+	InitializeTimeouts();
+	sigaction(SIGALRM, &host_sigalrm, &timeout_sigalrm);
+
+	autovac_timeout = RegisterTimeout(USER_TIMEOUT, autovac_timeout_handler);
+}
+
+/*
+ * run_autovac_target
+ *
+ * VACUUM (with ANALYZE if due) or ANALYZE one table, as if the statement
+ * had been sent by a client.
+ */
+static void
+run_autovac_target(AutoVacTarget *target)
+{
+	VacuumStmt *stmt = makeNode(VacuumStmt);
+	VacuumRelation *vrel;
+
+	StartTransactionCommand();
+
+	vrel = makeVacuumRelation(makeRangeVar(target->nspname, target->relname, -1),
+							  target->relid, NIL);
+	stmt->rels = list_make1(vrel);
+	stmt->is_vacuumcmd = target->dovacuum;
+	if (target->dovacuum && target->doanalyze)
+		stmt->options = list_make1(makeDefElem("analyze", NULL, -1));
+
+	/*
+	 * VACUUM runs every table in transactions of its own and pops the
+	 * snapshot; a lone ANALYZE runs in ours and needs one.
+	 */
+	PushActiveSnapshot(GetTransactionSnapshot());
+	ExecVacuum(make_parsestate(NULL), stmt, true);
+	if (ActiveSnapshotSet())
+		PopActiveSnapshot();
+
+	CommitTransactionCommand();
+}
+
+/*
+ * run_autovac_target_until
+ *
+ * Run one table with the autovacuum timeout armed for deadline.  A table
+ * that fails, or is cancelled by the timeout, is skipped with a log
+ * message rather than ending the slice.  Returns true if it completed.
+ */
+static bool
+run_autovac_target_until(AutoVacTarget *target, TimestampTz deadline)
+{
+	MemoryContext oldcxt = CurrentMemoryContext;
+	volatile bool done = false;
+
+	PG_TRY();
+	{
+		enable_timeout_at(autovac_timeout, deadline);
+		run_autovac_target(target);
+		disable_timeout(autovac_timeout, false);
+		done = true;
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		disable_timeout(autovac_timeout, false);
+		QueryCancelPending = false;
+
+		MemoryContextSwitchTo(oldcxt);
+		edata = CopyErrorData();
+		FlushErrorState();
+		AbortCurrentTransaction();
+		MemoryContextSwitchTo(oldcxt);
+
+		elog(LOG, "autovacuum of \"%s.%s\" skipped: %s",
+			 target->nspname, target->relname, edata->message);
+		FreeErrorData(edata);
+	}
+	PG_END_TRY();
+
+	return done;
+}
+
+/*
+ * set_cost_option
+ *
+ * Apply one of the autovacuum cost settings to the session's vacuum cost
+ * setting; returns the previous value to restore.
+ */
+static char *
+set_cost_option(MemoryContext cxt, const char *name, const char *autovac_name)
+{
+	const char *current = GetConfigOption(name, false, false);
+	const char *value = GetConfigOption(autovac_name, false, false);
+	char	   *saved = MemoryContextStrdup(cxt, current);
+
+	/* -1 means "use the regular vacuum setting" */
+	if (strcmp(value, "-1") != 0)
+		SetConfigOption(name, value, PGC_USERSET, PGC_S_SESSION);
+
+	return saved;
+}
+
+/*
+ * pg_embedded_autovacuum
+ *
+ * One slice of autovacuum: vacuum/analyze due tables, most urgent first,
+ * throttled by the autovacuum cost settings, until the budget runs out.
+ */
+int
+pg_embedded_autovacuum(uint64_t budget_us)
+{
+	MemoryContext cxt;
+	char	   *volatile saved_delay = NULL;
+	char	   *volatile saved_limit = NULL;
+	struct sigaction host_sigalrm;
+	volatile bool sigalrm_installed = false;
+	volatile int processed = 0;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot run maintenance inside a transaction");
+		return -1;
+	}
+
+	cxt = AllocSetContextCreate(TopMemoryContext, "embedded autovacuum",
+								ALLOCSET_DEFAULT_SIZES);
+
+	PG_TRY();
+	{
+		TimestampTz start = GetCurrentTimestamp();
+		TimestampTz deadline = TimestampTzPlusMicroseconds(start,
+														   (int64) budget_us);
+		AutoVacTarget *targets;
+		int			ntargets;
+		int			i;
+
+		/*
+		 * This backend's counters only reach the shared statistics when
+		 * flushed, which a standalone backend otherwise never does.
+		 */
+		pgstat_report_stat(true);
+
+		targets = collect_autovac_targets(cxt, &ntargets);
+
+		saved_delay = set_cost_option(cxt, "vacuum_cost_delay",
+									  "autovacuum_vacuum_cost_delay");
+		saved_limit = set_cost_option(cxt, "vacuum_cost_limit",
+									  "autovacuum_vacuum_cost_limit");
+		sigaction(SIGALRM, &timeout_sigalrm, &host_sigalrm);
+		sigalrm_installed = true;
+
+		for (i = 0; i < ntargets; i++)
+		{
+			AutoVacTarget *target = &targets[i];
+			TimestampTz now = GetCurrentTimestamp();
+			double		us_per_page = autovac_us_per_page > 0 ?
+				autovac_us_per_page : DEFAULT_AUTOVAC_US_PER_PAGE;
+			double		pages;
+
+			if (now >= deadline)
+				break;
+
+			/*
+			 * Don't start what the throughput seen so far says won't fit:
+			 * the deadline would cancel it and waste the work.  ANALYZE
+			 * reads a sample of at most 300 * default_statistics_target
+			 * pages.  Wraparound protection is started anyway, and left to
+			 * the deadline.
+			 */
+			pages = target->dovacuum ? target->relpages :
+				Min(target->relpages, 300.0 * default_statistics_target);
+			if (!target->wraparound &&
+				now + (TimestampTz) (us_per_page * pages) > deadline)
+				continue;
+
+			if (run_autovac_target_until(target, deadline))
+			{
+				processed++;
+
+				if (target->dovacuum && target->relpages > 0)
+				{
+					us_per_page = (double) (GetCurrentTimestamp() - now) /
+						target->relpages;
+					autovac_us_per_page = autovac_us_per_page > 0 ?
+						0.7 * autovac_us_per_page + 0.3 * us_per_page : us_per_page;
+				}
+			}
+		}
+
+		sigaction(SIGALRM, &host_sigalrm, NULL);
+		sigalrm_installed = false;
+		SetConfigOption("vacuum_cost_delay", saved_delay, PGC_USERSET, PGC_S_SESSION);
+		SetConfigOption("vacuum_cost_limit", saved_limit, PGC_USERSET, PGC_S_SESSION);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Autovacuum failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+
+		if (sigalrm_installed)
+			sigaction(SIGALRM, &host_sigalrm, NULL);
+		if (saved_delay)
+			SetConfigOption("vacuum_cost_delay", saved_delay, PGC_USERSET, PGC_S_SESSION);
+		if (saved_limit)
+			SetConfigOption("vacuum_cost_limit", saved_limit, PGC_USERSET, PGC_S_SESSION);
+		MemoryContextDelete(cxt);
+		return -1;
+	}
+	PG_END_TRY();
+
+	MemoryContextDelete(cxt);
+
+	return processed;
+}
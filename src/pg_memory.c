@@ -0,0 +1,817 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_memory.c
+ *	  Memory accounting and limits for the PostgreSQL Embedded API
+ *
+ * pack_archive.sh renames the malloc, realloc and free calls of the memory
+ * context implementations (aset.o, generation.o, slab.o, bump.o) to the
+ * pg_mmgr_* functions below, so every block any memory context gets from
+ * the system passes through here.  That is where the limits set with
+ * pg_embedded_set_memory_limits() are enforced: a block that would exceed
+ * one is refused, and the context reports the usual "out of memory" error,
+ * which aborts the statement instead of waking the OOM killer.
+ *
+ * Once a limit has been hit, allocations are let through until usage is
+ * back under it or the call ends, so that error handling and cleanup can
+ * still allocate.
+ *
+ * The blocks, and the pg_result structures handed to the host, come from
+ * the allocator installed with pg_embedded_set_allocator(), or from the C
+ * library if there is none.
+ *
+ * pg_embedded_memory_stats() reports the same per-context figures as
+ * MemoryContextStats(), as data instead of on stderr, and
+ * pg_embedded_release_memory() empties caches when the host needs the
+ * memory back.
+ *
+ * memory_budget_apply() sizes shared memory and the per-operation memory
+ * GUCs from pg_embedded_config.memory_budget, for the one backend that
+ * ever runs instead of the server's defaults.
+ *
+ * With transparent huge pages, shmem_advise_huge_pages() madvise()s the
+ * mapping that holds the buffer pool and the WAL buffers.  By then
+ * XLOGShmemInit() has zeroed the WAL buffers, faulting them in as small
+ * pages that only khugepaged may later collapse; a PRIVATE_SHMEM=1 build
+ * advises the mapping as soon as it is made instead (shmem_thp_requested).
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_memory.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "miscadmin.h"
+#include "nodes/memnodes.h"
+#include "storage/bufmgr.h"
+#include "storage/lock.h"
+#include "storage/proc.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/* Each block is preceded by its size; keeps malloc's alignment */
+#define MMGR_HEADER_SIZE	16
+
+static size_t mmgr_bytes = 0;		/* Held by all memory contexts */
+static size_t total_limit = 0;
+static size_t call_limit = 0;
+static size_t call_base = 0;		/* mmgr_bytes when the call started */
+static bool in_call = false;
+static bool limit_hit = false;
+
+static size_t memory_budget = 0;	/* as applied at init */
+static uintptr_t thp_advised = 0;	/* start of the madvise()d mapping */
+
+/* Read by embedded_shmem.c when it maps the segment */
+bool		shmem_thp_requested = false;
+
+/*
+ * How each profile splits the budget, in percent.  What is not given out
+ * here is left for the catalog and relation caches, plans and results,
+ * and for the fixed part of shared memory.
+ */
+static const struct
+{
+	int			shared_buffers;
+	int			work_mem;
+	int			maintenance_work_mem;
+	int			temp_buffers;
+	int			max_locks_per_transaction;
+}			memory_profiles[] = {
+	[PG_MEMORY_PROFILE_OLTP] = {50, 4, 10, 2, 128},
+	[PG_MEMORY_PROFILE_TINY] = {40, 2, 5, 2, 64},
+	[PG_MEMORY_PROFILE_ANALYTICS] = {30, 15, 20, 5, 256},
+};
+
+static pg_embedded_allocator allocator = {NULL, NULL, NULL, NULL};
+static bool allocator_used = false;	/* anything allocated yet? */
+
+void	   *pg_mmgr_malloc(size_t size);
+void	   *pg_mmgr_realloc(void *ptr, size_t size);
+void		pg_mmgr_free(void *ptr);
+
+/*
+ * host_malloc, host_calloc, host_realloc, host_strdup, host_free
+ *
+ * The host's allocator, or the C library's.
+ */
+void *
+host_malloc(size_t size)
+{
+	allocator_used = true;
+	if (allocator.malloc)
+		return allocator.malloc(size, allocator.arg);
+	return malloc(size);
+}
+
+void *
+host_calloc(size_t nmemb, size_t size)
+{
+	void	   *ptr;
+
+	if (size != 0 && nmemb > SIZE_MAX / size)
+		return NULL;
+	ptr = host_malloc(nmemb * size);
+	if (ptr)
+		memset(ptr, 0, nmemb * size);
+	return ptr;
+}
+
+void *
+host_realloc(void *ptr, size_t size)
+{
+	allocator_used = true;
+	if (allocator.realloc)
+		return allocator.realloc(ptr, size, allocator.arg);
+	return realloc(ptr, size);
+}
+
+char *
+host_strdup(const char *str)
+{
+	size_t		len = strlen(str) + 1;
+	char	   *copy = host_malloc(len);
+
+	if (copy)
+		memcpy(copy, str, len);
+	return copy;
+}
+
+void
+host_free(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	if (allocator.free)
+		allocator.free(ptr, allocator.arg);
+	else
+		free(ptr);
+}
+
+/*
+ * pg_embedded_set_allocator
+ *
+ * Install the host's allocator.  Memory must be freed by the allocator
+ * that gave it out, so this is only possible before anything was
+ * allocated.
+ */
+int
+pg_embedded_set_allocator(const pg_embedded_allocator *host)
+{
+	if (allocator_used)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "The allocator must be set before any other call");
+		return -1;
+	}
+
+	if (host == NULL)
+	{
+		memset(&allocator, 0, sizeof(allocator));
+		return 0;
+	}
+
+	if (!host->malloc || !host->realloc || !host->free)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "The allocator needs malloc, realloc and free");
+		return -1;
+	}
+
+	allocator = *host;
+	return 0;
+}
+
+/*
+ * mmgr_may_grow
+ *
+ * May the contexts hold another "add" bytes?
+ */
+static bool
+mmgr_may_grow(size_t add)
+{
+	size_t		after = mmgr_bytes + add;
+
+	if (limit_hit)
+		return true;
+
+	if ((total_limit > 0 && after > total_limit) ||
+		(in_call && call_limit > 0 && after > call_base &&
+		 after - call_base > call_limit))
+	{
+		limit_hit = true;
+		return false;
+	}
+
+	return true;
+}
+
+static void
+mmgr_shrunk(void)
+{
+	if (limit_hit &&
+		(total_limit == 0 || mmgr_bytes <= total_limit) &&
+		(!in_call || call_limit == 0 || mmgr_bytes <= call_base + call_limit))
+		limit_hit = false;
+}
+
+void *
+pg_mmgr_malloc(size_t size)
+{
+	char	   *block;
+
+	if (!mmgr_may_grow(size + MMGR_HEADER_SIZE))
+		return NULL;
+
+	block = host_malloc(size + MMGR_HEADER_SIZE);
+	if (block == NULL)
+		return NULL;
+
+	*(size_t *) block = size;
+	mmgr_bytes += size + MMGR_HEADER_SIZE;
+	return block + MMGR_HEADER_SIZE;
+}
+
+void *
+pg_mmgr_realloc(void *ptr, size_t size)
+{
+	char	   *block;
+	size_t		old_size;
+
+	if (ptr == NULL)
+		return pg_mmgr_malloc(size);
+
+	block = (char *) ptr - MMGR_HEADER_SIZE;
+	old_size = *(size_t *) block;
+	if (size > old_size && !mmgr_may_grow(size - old_size))
+		return NULL;
+
+	block = host_realloc(block, size + MMGR_HEADER_SIZE);
+	if (block == NULL)
+		return NULL;
+
+	*(size_t *) block = size;
+	mmgr_bytes = mmgr_bytes - old_size + size;
+	if (size < old_size)
+		mmgr_shrunk();
+	return block + MMGR_HEADER_SIZE;
+}
+
+void
+pg_mmgr_free(void *ptr)
+{
+	char	   *block;
+
+	if (ptr == NULL)
+		return;
+
+	block = (char *) ptr - MMGR_HEADER_SIZE;
+	mmgr_bytes -= *(size_t *) block + MMGR_HEADER_SIZE;
+	host_free(block);
+	mmgr_shrunk();
+}
+
+/*
+ * mmgr_call_begin / mmgr_call_end
+ *
+ * Bracket one top-level API call for the per-call limit.
+ */
+void
+mmgr_call_begin(void)
+{
+	in_call = true;
+	call_base = mmgr_bytes;
+	limit_hit = false;
+}
+
+void
+mmgr_call_end(void)
+{
+	in_call = false;
+	mmgr_shrunk();
+}
+
+/* Bytes currently held by all memory contexts */
+size_t
+mmgr_allocated_bytes(void)
+{
+	return mmgr_bytes;
+}
+
+/*
+ * pg_embedded_set_memory_limits
+ *
+ * Set the limits; 0 means no limit.  Lowering the total limit below the
+ * current usage doesn't free anything, it only refuses further growth.
+ */
+void
+pg_embedded_set_memory_limits(size_t total, size_t per_call)
+{
+	total_limit = total;
+	call_limit = per_call;
+	limit_hit = false;
+}
+
+static void
+set_memory_guc(const char *name, size_t kb, size_t min_kb, size_t max_kb)
+{
+	char		value[32];
+
+	kb = Max(kb, min_kb);
+	if (max_kb > 0)
+		kb = Min(kb, max_kb);
+	snprintf(value, sizeof(value), "%zukB", kb);
+	SetConfigOption(name, value, PGC_POSTMASTER, PGC_S_ARGV);
+}
+
+/*
+ * lock_table_size
+ *
+ * Shared memory of the heavyweight lock tables for max_locks per
+ * transaction, sized as LockManagerShmemSize() does for the process slots
+ * memory_budget_apply() leaves: the backend, the autovacuum slot and
+ * PostgreSQL's special worker processes.
+ */
+static size_t
+lock_table_size(int max_locks)
+{
+	long		nlocks = (long) max_locks * (1 + 1 + NUM_SPECIAL_WORKER_PROCS);
+
+	return hash_estimate_size(nlocks, sizeof(LOCK)) +
+		hash_estimate_size(nlocks * 2, sizeof(PROCLOCK));
+}
+
+/*
+ * memory_budget_apply
+ *
+ * Called from pg_embedded_init() before shared memory is sized.  Besides
+ * the memory GUCs, this cuts the process slots (and with them the lock
+ * table and ProcArray) down to what a single backend without background
+ * workers can use.  max_locks_per_transaction is raised instead, so the
+ * one backend can still lock as many objects.
+ *
+ * max_locks overrides the profile's max_locks_per_transaction when above
+ * zero.  The profile's shares leave room for the profile's own lock table;
+ * a bigger one is taken out of shared_buffers, so shared memory stays
+ * within the budget.
+ */
+void
+memory_budget_apply(size_t budget, pg_memory_profile profile, int max_locks)
+{
+	size_t		budget_kb = budget / 1024;
+	size_t		shared_buffers_kb;
+	size_t		lock_tables;
+	size_t		profile_lock_tables;
+	char		value[32];
+
+	if ((int) profile < 0 || profile > PG_MEMORY_PROFILE_ANALYTICS)
+		profile = PG_MEMORY_PROFILE_OLTP;
+	if (max_locks <= 0)
+		max_locks = memory_profiles[profile].max_locks_per_transaction;
+	memory_budget = budget;
+
+	/* Mins are PostgreSQL's own; wal_buffers follows its auto-tuning rule */
+	shared_buffers_kb = budget_kb * memory_profiles[profile].shared_buffers / 100;
+	lock_tables = lock_table_size(max_locks);
+	profile_lock_tables =
+		lock_table_size(memory_profiles[profile].max_locks_per_transaction);
+	if (lock_tables > profile_lock_tables)
+	{
+		size_t		extra_kb = (lock_tables - profile_lock_tables) / 1024;
+
+		shared_buffers_kb = shared_buffers_kb > extra_kb ?
+			shared_buffers_kb - extra_kb : 0;
+	}
+	shared_buffers_kb = Max(shared_buffers_kb, 16 * BLCKSZ / 1024);
+	set_memory_guc("shared_buffers", shared_buffers_kb, 16 * BLCKSZ / 1024, 0);
+	set_memory_guc("wal_buffers", shared_buffers_kb / 32,
+				   8 * XLOG_BLCKSZ / 1024, 16 * 1024);
+	set_memory_guc("work_mem",
+				   budget_kb * memory_profiles[profile].work_mem / 100, 64, 0);
+	set_memory_guc("maintenance_work_mem",
+				   budget_kb * memory_profiles[profile].maintenance_work_mem / 100,
+				   1024, 0);
+	set_memory_guc("temp_buffers",
+				   budget_kb * memory_profiles[profile].temp_buffers / 100,
+				   100 * BLCKSZ / 1024, 0);
+
+	snprintf(value, sizeof(value), "%d", max_locks);
+	SetConfigOption("max_locks_per_transaction", value,
+					PGC_POSTMASTER, PGC_S_ARGV);
+
+	SetConfigOption("max_connections", "1", PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("superuser_reserved_connections", "0",
+					PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("reserved_connections", "0", PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("autovacuum_worker_slots", "1", PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("autovacuum_max_workers", "1", PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("max_worker_processes", "0", PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("max_parallel_workers", "0", PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("max_parallel_workers_per_gather", "0",
+					PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("max_parallel_maintenance_workers", "0",
+					PGC_POSTMASTER, PGC_S_ARGV);
+	SetConfigOption("max_wal_senders", "0", PGC_POSTMASTER, PGC_S_ARGV);
+}
+
+/*
+ * shmem_mapping
+ *
+ * Find the mapping that holds the buffer pool in /proc/self/maps.  The
+ * whole main shared memory segment, WAL buffers included, is in it.
+ */
+static bool
+shmem_mapping(uintptr_t *start, uintptr_t *end)
+{
+	uintptr_t	addr = (uintptr_t) BufferBlocks;
+	char		line[MAXPGPATH + 128];
+	bool		found = false;
+	FILE	   *fp;
+
+	if (BufferBlocks == NULL || (fp = fopen("/proc/self/maps", "r")) == NULL)
+		return false;
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		unsigned long lo;
+		unsigned long hi;
+
+		if (sscanf(line, "%lx-%lx", &lo, &hi) == 2 && addr >= lo && addr < hi)
+		{
+			*start = lo;
+			*end = hi;
+			found = true;
+			break;
+		}
+	}
+	fclose(fp);
+	return found;
+}
+
+/*
+ * shmem_huge_page_bytes
+ *
+ * How much of the mapping at "start" is backed by huge pages, per
+ * /proc/self/smaps: transparent ones (private or shared) and hugetlbfs.
+ */
+static size_t
+shmem_huge_page_bytes(uintptr_t start)
+{
+	char		line[MAXPGPATH + 128];
+	bool		in_mapping = false;
+	size_t		kb = 0;
+	FILE	   *fp = fopen("/proc/self/smaps", "r");
+
+	if (fp == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		unsigned long lo;
+		unsigned long hi;
+		unsigned long value;
+		char		name[64];
+
+		/* A mapping's header line, then one "Name: value kB" line per field */
+		if (sscanf(line, "%lx-%lx %63s", &lo, &hi, name) == 3)
+		{
+			if (in_mapping)
+				break;
+			in_mapping = (lo == start);
+		}
+		else if (in_mapping &&
+				 sscanf(line, "%63[^:]: %lu kB", name, &value) == 2 &&
+				 (strcmp(name, "AnonHugePages") == 0 ||
+				  strcmp(name, "ShmemPmdMapped") == 0 ||
+				  strcmp(name, "Shared_Hugetlb") == 0 ||
+				  strcmp(name, "Private_Hugetlb") == 0))
+			kb += value;
+	}
+	fclose(fp);
+	return kb * 1024;
+}
+
+/*
+ * shmem_advise_huge_pages
+ *
+ * Ask for transparent huge pages on the shared memory segment.  Called
+ * right after it is created, before the buffer pool is first touched.
+ * The kernel may still decline; pg_embedded_memory_footprint() tells.
+ */
+void
+shmem_advise_huge_pages(void)
+{
+	uintptr_t	start;
+	uintptr_t	end;
+
+	thp_advised = 0;
+	if (!shmem_mapping(&start, &end))
+	{
+		elog(LOG, "could not find the shared memory mapping");
+		return;
+	}
+
+#ifdef MADV_HUGEPAGE
+	if (madvise((void *) start, end - start, MADV_HUGEPAGE) == 0)
+		thp_advised = start;
+	else
+		elog(LOG, "madvise(MADV_HUGEPAGE) of %zu bytes failed: %m",
+			 (size_t) (end - start));
+#endif
+}
+
+/* Size in bytes of a memory GUC, whatever its unit */
+static size_t
+memory_guc_bytes(const char *name, int unit_flags, size_t unit_bytes)
+{
+	const char *value = GetConfigOption(name, true, false);
+	int			units;
+
+	if (!value || !parse_int(value, &units, unit_flags, NULL) || units < 0)
+		return 0;
+	return (size_t) units * unit_bytes;
+}
+
+/*
+ * pg_embedded_memory_footprint
+ */
+int
+pg_embedded_memory_footprint(pg_memory_footprint *out)
+{
+	uintptr_t	start;
+	uintptr_t	end;
+
+	if (!out)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "NULL argument");
+		return -1;
+	}
+	memset(out, 0, sizeof(pg_memory_footprint));
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	out->budget = memory_budget;
+	out->shared_memory_bytes = memory_guc_bytes("shared_memory_size",
+												GUC_UNIT_MB, 1024 * 1024);
+	out->shared_buffers_bytes = (size_t) NBuffers * BLCKSZ;
+	out->wal_buffers_bytes = (size_t) XLOGbuffers * XLOG_BLCKSZ;
+	out->work_mem_bytes = (size_t) work_mem * 1024;
+	out->maintenance_work_mem_bytes = (size_t) maintenance_work_mem * 1024;
+	out->temp_buffers_bytes = memory_guc_bytes("temp_buffers",
+											   GUC_UNIT_BLOCKS, BLCKSZ);
+	out->max_backends = MaxBackends;
+	out->max_locks_per_transaction = max_locks_per_xact;
+	out->fast_path_lock_slots = FastPathLockSlotsPerBackend();
+
+	out->huge_pages = PG_HUGE_PAGES_OFF;
+	if (shmem_mapping(&start, &end))
+	{
+		const char *status = GetConfigOption("huge_pages_status", true, false);
+
+		out->huge_page_bytes = shmem_huge_page_bytes(start);
+		if (status && strcmp(status, "on") == 0)
+		{
+			/* Reserved at mmap() time, but only counted once touched */
+			out->huge_pages = PG_HUGE_PAGES_ON;
+			out->huge_page_bytes = end - start;
+		}
+		else if (start == thp_advised)
+			out->huge_pages = PG_HUGE_PAGES_TRANSPARENT;
+	}
+
+	return 0;
+}
+
+/*
+ * add_context_stats
+ *
+ * Append the figures of one context (not its children) to the array.
+ */
+static bool
+add_context_stats(pg_memory_stats *out, int *alloc, MemoryContext context,
+				  int level, int parent)
+{
+	pg_memory_context_stats *entry;
+	MemoryContextCounters counters;
+
+	if (out->ncontexts == *alloc)
+	{
+		int			newalloc = Max(*alloc * 2, 64);
+		pg_memory_context_stats *contexts;
+
+		contexts = host_realloc(out->contexts,
+								newalloc * sizeof(pg_memory_context_stats));
+		if (!contexts)
+			return false;
+		out->contexts = contexts;
+		*alloc = newalloc;
+	}
+
+	memset(&counters, 0, sizeof(counters));
+	context->methods->stats(context, NULL, NULL, &counters, false);
+
+	entry = &out->contexts[out->ncontexts++];
+	memset(entry, 0, sizeof(pg_memory_context_stats));
+	strlcpy(entry->name, context->name, sizeof(entry->name));
+	if (context->ident)
+		strlcpy(entry->ident, context->ident, sizeof(entry->ident));
+	entry->level = level;
+	entry->parent = parent;
+	entry->total_bytes = counters.totalspace;
+	entry->free_bytes = counters.freespace;
+	entry->used_bytes = counters.totalspace - counters.freespace;
+	entry->blocks = counters.nblocks;
+	entry->free_chunks = counters.freechunks;
+
+	out->total_bytes += counters.totalspace;
+	out->used_bytes += counters.totalspace - counters.freespace;
+
+	return true;
+}
+
+/*
+ * pg_embedded_memory_stats
+ *
+ * Walk the whole context tree from TopMemoryContext, parents before their
+ * children.
+ */
+int
+pg_embedded_memory_stats(pg_memory_stats *out)
+{
+	MemoryContext context;
+	const char *shmem_mb;
+	int			alloc = 0;
+	int			level = 0;
+	int			parent = -1;
+
+	if (!out)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "NULL argument");
+		return -1;
+	}
+	memset(out, 0, sizeof(pg_memory_stats));
+
+	if (!pg_embedded_is_initialized() || TopMemoryContext == NULL)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	/* Depth-first, without recursion: the tree can be deep */
+	context = TopMemoryContext;
+	while (context != NULL)
+	{
+		if (!add_context_stats(out, &alloc, context, level, parent))
+		{
+			pg_embedded_free_memory_stats(out);
+			snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+			return -1;
+		}
+
+		if (context->firstchild != NULL)
+		{
+			parent = out->ncontexts - 1;
+			level++;
+			context = context->firstchild;
+			continue;
+		}
+
+		/* Go up until there is a next sibling */
+		while (context != NULL && context->nextchild == NULL)
+		{
+			context = context->parent;
+			if (context != NULL)
+			{
+				level--;
+				parent = out->contexts[parent].parent;
+			}
+		}
+		if (context != NULL)
+			context = context->nextchild;
+	}
+
+	out->system_bytes = mmgr_bytes;
+
+	/* Reported by PostgreSQL in MB, rounded up */
+	shmem_mb = GetConfigOption("shared_memory_size", true, false);
+	if (shmem_mb)
+		out->shared_memory_bytes = (size_t) strtoull(shmem_mb, NULL, 10) * 1024 * 1024;
+
+	return 0;
+}
+
+/* Free the context array of a pg_memory_stats */
+void
+pg_embedded_free_memory_stats(pg_memory_stats *stats)
+{
+	if (!stats)
+		return;
+	host_free(stats->contexts);
+	stats->contexts = NULL;
+	stats->ncontexts = 0;
+}
+
+/*
+ * pg_embedded_release_memory
+ *
+ * Give memory back under host memory pressure.  Each level includes the
+ * ones below it:
+ *
+ * LOW drops the result cache, which lives in host memory outside the
+ * backend's contexts, and trims MessageContext, where results are built,
+ * down to its first block.  MEDIUM also drops the literal plan cache,
+ * deleting the contexts of its plans, and invalidates the catalog and
+ * relation caches; relcache entries not in use are destroyed with their
+ * contexts, and catcache entries are freed.  HIGH also drops the plans of
+ * named and live queries, which are prepared again when next used.
+ *
+ * Returns what actually went back to the host's allocator: the result
+ * cache's bytes, plus the drop in blocks held by all memory contexts.
+ * AllocSet keeps a block until the whole context is reset, so catcache
+ * entries freed inside CacheMemoryContext are reused by later entries but
+ * not counted.
+ */
+int64_t
+pg_embedded_release_memory(pg_memory_pressure level)
+{
+	pg_result_cache_stats rc_stats;
+	size_t		before;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot release memory inside a transaction");
+		return -1;
+	}
+
+	pg_embedded_result_cache_stats(&rc_stats);
+	before = mmgr_bytes;
+
+	pg_embedded_result_cache_clear();
+
+	/* Outside a transaction, so not inside a pg_embedded_exec() either */
+	MemoryContextReset(MessageContext);
+
+	if (level >= PG_MEMORY_PRESSURE_HIGH)
+	{
+		named_query_release();
+		live_query_release();
+	}
+
+	if (level >= PG_MEMORY_PRESSURE_MEDIUM)
+	{
+		pg_embedded_plan_cache_clear();
+
+		PG_TRY();
+		{
+			/* Rebuilding nailed relcache entries reads the catalogs */
+			StartTransactionCommand();
+			InvalidateSystemCaches();
+			CommitTransactionCommand();
+		}
+		PG_CATCH();
+		{
+			ErrorData  *edata;
+
+			edata = CopyErrorData();
+			snprintf(pg_error_msg, sizeof(pg_error_msg),
+					 "Cache invalidation failed: %s", edata->message);
+			FlushErrorState();
+			FreeErrorData(edata);
+			AbortCurrentTransaction();
+			return -1;
+		}
+		PG_END_TRY();
+	}
+
+	return (int64_t) rc_stats.bytes +
+		(before > mmgr_bytes ? (int64_t) (before - mmgr_bytes) : 0);
+}
@@ -0,0 +1,786 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_named_query.c
+ *	  Precompiled named queries for the PostgreSQL Embedded API
+ *
+ * An application whose SQL is fixed at build time can run it through
+ * helpers/querygen, which analyzes and rewrites every query against the
+ * application schema and emits a table of pg_named_query entries holding
+ * the nodeToString() form of the resulting Query trees.  Any SQL error is
+ * a build error.
+ *
+ * At runtime pg_embedded_exec_named() reads the trees back with
+ * stringToNode() on first use and makes them the starting point of a saved
+ * CachedPlanSource with a generic plan; the analyzer doesn't run.  Only
+ * the grammar parses the SQL text, once, because the plan cache analyzes
+ * it again when an invalidation (DDL on a relation the query uses, a
+ * changed function or type, another search_path) makes the trees stale.
+ *
+ * Query trees refer to relations by OID and to columns by number.  The
+ * entry records which name and row type each OID had at build time; if
+ * the database was set up differently, or the trees come from another
+ * catalog version, the query is analyzed from its SQL text instead, once,
+ * and everything else works the same.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_named_query.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/relation.h"
+#include "access/xact.h"
+#include "catalog/catversion.h"
+#include "catalog/pg_type.h"
+#include "executor/executor.h"
+#include "executor/spi.h"
+#include "lib/stringinfo.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/params.h"
+#include "parser/analyze.h"
+#include "parser/parser.h"
+#include "tcop/dest.h"
+#include "tcop/tcopprot.h"
+#include "tcop/utility.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/plancache.h"
+#include "utils/rel.h"
+#include "utils/resowner.h"
+#include "utils/snapmgr.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/* Runtime state of one registered query */
+typedef struct NamedQueryState
+{
+	CachedPlanSource *plansource;	/* saved; NULL if not loaded */
+} NamedQueryState;
+
+static const pg_named_query *named_queries = NULL;
+static int	num_named_queries = 0;
+static NamedQueryState *named_state = NULL;
+
+/* DestReceiver collecting the rows of the tag-setting statement */
+typedef struct NamedQueryDest
+{
+	DestReceiver pub;
+	pg_result  *result;
+	uint64		alloc_rows;
+	FmgrInfo   *out_funcs;
+} NamedQueryDest;
+
+/*
+ * named_query_reset
+ *
+ * Called on every pg_embedded_init: the loaded trees and plans died with
+ * the previous instance's memory.  Registrations survive.
+ */
+void
+named_query_reset(void)
+{
+	if (named_state)
+		memset(named_state, 0, num_named_queries * sizeof(NamedQueryState));
+}
+
+/*
+ * named_query_release
+ *
+ * Free the loaded trees and plans to save memory; they are loaded again on
+ * next use.
+ */
+void
+named_query_release(void)
+{
+	int			i;
+
+	for (i = 0; i < num_named_queries; i++)
+	{
+		if (named_state[i].plansource)
+			DropCachedPlan(named_state[i].plansource);
+		memset(&named_state[i], 0, sizeof(NamedQueryState));
+	}
+}
+
+/*
+ * pg_embedded_register_named_queries
+ *
+ * Register the table generated by helpers/querygen.  The table is not
+ * copied and must stay valid; registering again replaces it.
+ */
+int
+pg_embedded_register_named_queries(const pg_named_query *queries, int count)
+{
+	NamedQueryState *state;
+	int			i;
+
+	if (count < 0 || (count > 0 && queries == NULL))
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Invalid query table");
+		return -1;
+	}
+
+	state = (NamedQueryState *) host_calloc(Max(count, 1), sizeof(NamedQueryState));
+	if (!state)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+		return -1;
+	}
+
+	/* Plans of the old table live in CacheMemoryContext */
+	for (i = 0; i < num_named_queries; i++)
+	{
+		if (named_state[i].plansource)
+			DropCachedPlan(named_state[i].plansource);
+	}
+	host_free(named_state);
+
+	named_queries = queries;
+	num_named_queries = count;
+	named_state = state;
+	return 0;
+}
+
+/*
+ * collect_relids_walker
+ *
+ * Collect the OIDs of all relations a Query tree references, including
+ * those in subqueries, CTEs and sublinks.
+ */
+static bool
+collect_relids_walker(Node *node, List **relids)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, RangeTblEntry))
+	{
+		RangeTblEntry *rte = (RangeTblEntry *) node;
+
+		if (rte->rtekind == RTE_RELATION)
+			*relids = list_append_unique_oid(*relids, rte->relid);
+		return false;
+	}
+	if (IsA(node, Query))
+		return query_tree_walker((Query *) node, collect_relids_walker,
+								 relids, QTW_EXAMINE_RTES_BEFORE);
+	return expression_tree_walker(node, collect_relids_walker, relids);
+}
+
+static List *
+collect_relids(List *queries)
+{
+	List	   *relids = NIL;
+	ListCell   *lc;
+
+	foreach(lc, queries)
+		collect_relids_walker(lfirst(lc), &relids);
+	return relids;
+}
+
+/*
+ * describe_relations
+ *
+ * "oid:schema.name(column type typmod,...)" for each relation the trees
+ * reference, in walk order, with "-" for a dropped column.  Comparing the
+ * build-time string with the current one tells whether the trees' OIDs
+ * and column numbers still mean the same relations and columns.  NULL if
+ * one no longer exists.
+ */
+static char *
+describe_relations(List *queries)
+{
+	StringInfoData buf;
+	List	   *relids = collect_relids(queries);
+	ListCell   *lc;
+
+	initStringInfo(&buf);
+	foreach(lc, relids)
+	{
+		Oid			relid = lfirst_oid(lc);
+		Relation	rel = try_relation_open(relid, AccessShareLock);
+		TupleDesc	tupdesc;
+		char	   *nspname;
+		int			i;
+
+		if (rel == NULL)
+			return NULL;
+		nspname = get_namespace_name(RelationGetNamespace(rel));
+		if (nspname == NULL)
+		{
+			relation_close(rel, AccessShareLock);
+			return NULL;
+		}
+
+		appendStringInfo(&buf, "%s%u:%s(", buf.len > 0 ? " " : "", relid,
+						 quote_qualified_identifier(nspname,
+													RelationGetRelationName(rel)));
+		tupdesc = RelationGetDescr(rel);
+		for (i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+			if (i > 0)
+				appendStringInfoChar(&buf, ',');
+			if (attr->attisdropped)
+				appendStringInfoChar(&buf, '-');
+			else
+				appendStringInfo(&buf, "%s %u %d",
+								 quote_identifier(NameStr(attr->attname)),
+								 attr->atttypid, attr->atttypmod);
+		}
+		appendStringInfoChar(&buf, ')');
+
+		/* Keep the lock, the trees are used under it */
+		relation_close(rel, NoLock);
+	}
+	list_free(relids);
+	return buf.data;
+}
+
+/* Parse a statement that must be the only one in sql */
+static RawStmt *
+parse_query(const char *sql)
+{
+	List	   *raw = raw_parser(sql, RAW_PARSE_DEFAULT);
+
+	if (list_length(raw) != 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("a named query must be exactly one statement")));
+	return linitial_node(RawStmt, raw);
+}
+
+/*
+ * analyze_query
+ *
+ * Analyze and rewrite a parsed statement.  With paramTypes pointing to
+ * NULL the parameter types are inferred and returned; otherwise they are
+ * taken as given.
+ */
+static List *
+analyze_query(RawStmt *raw, const char *sql, Oid **paramTypes, int *numParams)
+{
+	Query	   *query;
+	int			i;
+
+	/* The analyzer scribbles on its input */
+	raw = copyObject(raw);
+
+	if (*paramTypes == NULL)
+	{
+		query = parse_analyze_varparams(raw, sql,
+										paramTypes, numParams, NULL);
+		for (i = 0; i < *numParams; i++)
+		{
+			if ((*paramTypes)[i] == InvalidOid ||
+				(*paramTypes)[i] == UNKNOWNOID)
+				ereport(ERROR,
+						(errcode(ERRCODE_INDETERMINATE_DATATYPE),
+						 errmsg("could not determine data type of parameter $%d",
+								i + 1)));
+		}
+	}
+	else
+		query = parse_analyze_fixedparams(raw, sql,
+										  *paramTypes, *numParams, NULL);
+
+	if (query->commandType == CMD_UTILITY)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("only SELECT, INSERT, UPDATE, DELETE and MERGE can be named queries")));
+
+	return pg_rewrite_query(query);
+}
+
+/*
+ * pg_embedded_compile_query
+ *
+ * Analyze and rewrite a query against the current schema and return the
+ * strings helpers/querygen puts into a pg_named_query.  Parameter types
+ * are inferred from the query.
+ */
+int
+pg_embedded_compile_query(const char *sql, pg_compiled_query *out)
+{
+	volatile bool implicit_tx = false;
+	MemoryContext oldcxt = CurrentMemoryContext;
+	int			ret = -1;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+	if (exec_reentry_forbidden())
+		return -1;
+	if (!sql || !out)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "NULL argument");
+		return -1;
+	}
+	memset(out, 0, sizeof(pg_compiled_query));
+
+	PG_TRY();
+	{
+		Oid		   *paramTypes = NULL;
+		int			numParams = 0;
+		List	   *queries;
+		char	   *relations;
+		char	   *tree;
+
+		if (!IsTransactionState())
+		{
+			StartTransactionCommand();
+			implicit_tx = true;
+		}
+
+		PushActiveSnapshot(GetTransactionSnapshot());
+		queries = analyze_query(parse_query(sql), sql, &paramTypes, &numParams);
+		PopActiveSnapshot();
+
+		tree = nodeToString(queries);
+		relations = describe_relations(queries);
+
+		out->query = host_strdup(tree);
+		out->relations = host_strdup(relations ? relations : "");
+		out->catversion = CATALOG_VERSION_NO;
+		out->nparams = numParams;
+		out->param_types = (unsigned int *)
+			host_malloc(Max(numParams, 1) * sizeof(unsigned int));
+		if (out->query && out->relations && out->param_types)
+		{
+			int			i;
+
+			for (i = 0; i < numParams; i++)
+				out->param_types[i] = paramTypes[i];
+			ret = 0;
+		}
+		else
+			snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+
+		if (implicit_tx)
+			CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(oldcxt);
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Query compilation failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+	}
+	PG_END_TRY();
+
+	if (ret != 0)
+		pg_embedded_free_compiled_query(out);
+	return ret;
+}
+
+/* Free the strings of a pg_compiled_query */
+void
+pg_embedded_free_compiled_query(pg_compiled_query *compiled)
+{
+	if (!compiled)
+		return;
+	host_free(compiled->query);
+	host_free(compiled->relations);
+	host_free(compiled->param_types);
+	memset(compiled, 0, sizeof(pg_compiled_query));
+}
+
+/*
+ * named_query_load
+ *
+ * Make the saved plan source of an entry, starting from its embedded Query
+ * trees when they are still valid for this database, otherwise from its
+ * SQL text.
+ */
+static void
+named_query_load(const pg_named_query *nq, NamedQueryState *state)
+{
+	MemoryContext tmpcxt;
+	MemoryContext oldcxt;
+	CachedPlanSource *plansource;
+	RawStmt    *raw;
+	List	   *queries = NIL;
+	Oid		   *paramTypes;
+	int			numParams = nq->nparams;
+	int			i;
+
+	tmpcxt = AllocSetContextCreate(CurrentMemoryContext, "named query load",
+								   ALLOCSET_SMALL_SIZES);
+	oldcxt = MemoryContextSwitchTo(tmpcxt);
+
+	paramTypes = (Oid *) palloc(Max(nq->nparams, 1) * sizeof(Oid));
+	for (i = 0; i < nq->nparams; i++)
+		paramTypes[i] = nq->param_types[i];
+
+	raw = parse_query(nq->sql);
+
+	if (nq->query && nq->catversion == CATALOG_VERSION_NO)
+	{
+		char	   *relations;
+
+		queries = (List *) stringToNode(nq->query);
+		relations = describe_relations(queries);
+		if (relations == NULL || strcmp(relations, nq->relations ? nq->relations : "") != 0)
+		{
+			ereport(DEBUG1,
+					(errmsg("named query \"%s\" was compiled against a different schema, analyzing it again",
+							nq->name)));
+			queries = NIL;
+		}
+	}
+
+	if (queries == NIL)
+		queries = analyze_query(raw, nq->sql, &paramTypes, &numParams);
+
+	/* A generic plan, as the trees were meant for */
+	plansource = CreateCachedPlan(raw, nq->sql, CreateCommandTag((Node *) raw->stmt));
+	CompleteCachedPlan(plansource, queries, NULL, paramTypes, numParams,
+					   NULL, NULL, CURSOR_OPT_GENERIC_PLAN, false);
+	SaveCachedPlan(plansource);
+	state->plansource = plansource;
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(tmpcxt);
+}
+
+static void
+named_dest_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+	NamedQueryDest *dest = (NamedQueryDest *) self;
+	pg_result  *result = dest->result;
+	int			col;
+
+	result->cols = typeinfo->natts;
+	result->colnames = (char **) host_calloc(Max(result->cols, 1), sizeof(char *));
+	if (!result->colnames)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+
+	dest->out_funcs = (FmgrInfo *) palloc(Max(result->cols, 1) * sizeof(FmgrInfo));
+	for (col = 0; col < result->cols; col++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(typeinfo, col);
+		Oid			typoutput;
+		bool		typisvarlena;
+
+		result->colnames[col] = host_strdup(NameStr(attr->attname));
+		getTypeOutputInfo(attr->atttypid, &typoutput, &typisvarlena);
+		fmgr_info(typoutput, &dest->out_funcs[col]);
+	}
+}
+
+static bool
+named_dest_receive(TupleTableSlot *slot, DestReceiver *self)
+{
+	NamedQueryDest *dest = (NamedQueryDest *) self;
+	pg_result  *result = dest->result;
+	char	  **row;
+	int			col;
+
+	if (result->rows == dest->alloc_rows)
+	{
+		uint64		newalloc = Max(dest->alloc_rows * 2, 16);
+		char	 ***values = (char ***) host_realloc(result->values,
+											   newalloc * sizeof(char **));
+
+		if (!values)
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+		result->values = values;
+		dest->alloc_rows = newalloc;
+	}
+
+	row = (char **) host_calloc(Max(result->cols, 1), sizeof(char *));
+	if (!row)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	result->values[result->rows++] = row;
+
+	slot_getallattrs(slot);
+	for (col = 0; col < result->cols; col++)
+	{
+		if (slot->tts_isnull[col])
+			row[col] = NULL;
+		else
+		{
+			char	   *str = OutputFunctionCall(&dest->out_funcs[col],
+												 slot->tts_values[col]);
+
+			row[col] = host_strdup(str);
+			pfree(str);
+		}
+	}
+
+	return true;
+}
+
+static void
+named_dest_shutdown(DestReceiver *self)
+{
+}
+
+static void
+named_dest_destroy(DestReceiver *self)
+{
+}
+
+/* SPI status code pg_embedded_exec would report for the statement */
+static int
+named_query_status(PlannedStmt *stmt)
+{
+	switch (stmt->commandType)
+	{
+		case CMD_SELECT:
+			return SPI_OK_SELECT;
+		case CMD_INSERT:
+			return stmt->hasReturning ? SPI_OK_INSERT_RETURNING : SPI_OK_INSERT;
+		case CMD_UPDATE:
+			return stmt->hasReturning ? SPI_OK_UPDATE_RETURNING : SPI_OK_UPDATE;
+		case CMD_DELETE:
+			return stmt->hasReturning ? SPI_OK_DELETE_RETURNING : SPI_OK_DELETE;
+		case CMD_MERGE:
+			return stmt->hasReturning ? SPI_OK_MERGE_RETURNING : SPI_OK_MERGE;
+		default:
+			return SPI_ERROR_OPUNKNOWN;
+	}
+}
+
+/*
+ * make_params
+ *
+ * Convert the text parameter values with the input functions of the
+ * query's parameter types.  A NULL value is an SQL NULL.
+ */
+static ParamListInfo
+make_params(const pg_named_query *nq, const char *const *values)
+{
+	ParamListInfo params;
+	int			i;
+
+	if (nq->nparams == 0)
+		return NULL;
+
+	params = makeParamList(nq->nparams);
+	for (i = 0; i < nq->nparams; i++)
+	{
+		ParamExternData *prm = &params->params[i];
+		Oid			typinput;
+		Oid			typioparam;
+
+		getTypeInputInfo(nq->param_types[i], &typinput, &typioparam);
+		prm->ptype = nq->param_types[i];
+		prm->pflags = PARAM_FLAG_CONST;
+		prm->isnull = (values[i] == NULL);
+		prm->value = OidInputFunctionCall(typinput, (char *) values[i],
+										  typioparam, -1);
+	}
+
+	return params;
+}
+
+/*
+ * pg_embedded_exec_named
+ *
+ * Execute a registered query with text parameter values (NULL for an SQL
+ * NULL).  The result has the same form as pg_embedded_exec's.
+ */
+pg_result *
+pg_embedded_exec_named(int id, int nparams, const char *const *values)
+{
+	pg_result  *result;
+	const pg_named_query *nq;
+	NamedQueryState *state;
+	MemoryContext oldcxt;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	bool		in_tx;
+	int			depth;
+	volatile bool implicit_tx = false;
+	volatile bool subxact = false;
+	volatile bool snapshot_pushed = false;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return NULL;
+	}
+
+	if (exec_reentry_forbidden())
+		return NULL;
+
+	if (id < 0 || id >= num_named_queries)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Unknown named query %d", id);
+		return NULL;
+	}
+	nq = &named_queries[id];
+	state = &named_state[id];
+
+	if (nparams != nq->nparams || (nparams > 0 && values == NULL))
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Named query \"%s\" takes %d parameters, got %d",
+				 nq->name, nq->nparams, nparams);
+		return NULL;
+	}
+
+	result = (pg_result *) host_malloc(sizeof(pg_result));
+	if (!result)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+		return NULL;
+	}
+	memset(result, 0, sizeof(pg_result));
+
+	/* Bracketed like pg_embedded_exec, which this may be called back from */
+	depth = exec_call_begin();
+	in_tx = IsTransactionState();
+	oldcxt = MemoryContextSwitchTo(MessageContext);
+
+	PG_TRY();
+	{
+		ParamListInfo params;
+		NamedQueryDest dest;
+		CachedPlan *cplan;
+		ListCell   *lc;
+
+		if (!IsTransactionState())
+		{
+			StartTransactionCommand();
+			implicit_tx = true;
+		}
+		else if (depth > 1)
+		{
+			/* An error may only roll back this call's own work */
+			BeginInternalSubTransaction(NULL);
+			MemoryContextSwitchTo(MessageContext);
+			subxact = true;
+		}
+
+		PushActiveSnapshot(GetTransactionSnapshot());
+		snapshot_pushed = true;
+
+		if (state->plansource == NULL)
+			named_query_load(nq, state);
+
+		/* Locks the relations, and analyzes and plans again if stale */
+		params = make_params(nq, values);
+		cplan = GetCachedPlan(state->plansource, params,
+							  CurrentResourceOwner, NULL);
+
+		memset(&dest, 0, sizeof(dest));
+		dest.pub.receiveSlot = named_dest_receive;
+		dest.pub.rStartup = named_dest_startup;
+		dest.pub.rShutdown = named_dest_shutdown;
+		dest.pub.rDestroy = named_dest_destroy;
+		dest.pub.mydest = DestNone;
+		dest.result = result;
+
+		foreach(lc, cplan->stmt_list)
+		{
+			PlannedStmt *stmt = lfirst_node(PlannedStmt, lc);
+			QueryDesc  *qd;
+
+			/* Rule actions run before or after the original statement */
+			if (foreach_current_index(lc) > 0)
+			{
+				CommandCounterIncrement();
+				PopActiveSnapshot();
+				PushActiveSnapshot(GetTransactionSnapshot());
+			}
+
+			qd = CreateQueryDesc(stmt, nq->sql, GetActiveSnapshot(),
+								 InvalidSnapshot,
+								 stmt->canSetTag ? (DestReceiver *) &dest : None_Receiver,
+								 params, NULL, 0);
+			ExecutorStart(qd, 0);
+			ExecutorRun(qd, ForwardScanDirection, 0);
+			ExecutorFinish(qd);
+
+			if (stmt->canSetTag)
+			{
+				result->status = named_query_status(stmt);
+				if (!stmt->hasReturning && stmt->commandType != CMD_SELECT)
+					result->rows = qd->estate->es_processed;
+			}
+
+			ExecutorEnd(qd);
+			FreeQueryDesc(qd);
+		}
+		CommandCounterIncrement();
+		ReleaseCachedPlan(cplan, CurrentResourceOwner);
+
+		snapshot_pushed = false;
+		PopActiveSnapshot();
+
+		if (subxact)
+		{
+			ReleaseCurrentSubTransaction();
+			subxact = false;
+			MemoryContextSwitchTo(MessageContext);
+			CurrentResourceOwner = oldowner;
+		}
+
+		if (implicit_tx)
+			CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(MessageContext);
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Query failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		if (subxact)
+		{
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(MessageContext);
+			CurrentResourceOwner = oldowner;
+		}
+		else
+		{
+			if (snapshot_pushed)
+				PopActiveSnapshot();
+			AbortCurrentTransaction();
+		}
+
+		pg_embedded_free_result(result);
+		result = (pg_result *) host_calloc(1, sizeof(pg_result));
+		if (result)
+			result->status = -1;
+	}
+	PG_END_TRY();
+
+	/* As in pg_embedded_exec: an aborted host transaction took oldcxt */
+	if (!in_tx || IsTransactionState())
+		MemoryContextSwitchTo(oldcxt);
+	else
+		MemoryContextSwitchTo(TopMemoryContext);
+	exec_call_end();
+
+	return result;
+}
@@ -0,0 +1,788 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_plan_cache.c
+ *	  Plan cache with literal parameterization for the Embedded API
+ *
+ * When enabled with pg_embedded_set_plan_cache_size(), pg_embedded_exec()
+ * replaces the literals of a query by parameters, keeps one SPI plan per
+ * resulting query shape and executes it with the literals bound as
+ * parameter values.  "WHERE id = 1" and "WHERE id = 2" then share a plan,
+ * and the plancache chooses between custom and generic plans for it the
+ * same way it does for prepared statements.
+ *
+ * Which literals become parameters is decided the way pg_stat_statements
+ * normalizes queries: the first time a shape is seen, the query is
+ * analyzed and jumbled, and only the constants the jumble records are
+ * replaced.  An ORDER BY 1 keeps its 1, and a parameter gets the type its
+ * constant had.  A replaced query that fails to prepare, or returns other
+ * column types than the original, is remembered and its shape always runs
+ * as written.  Later queries of a known shape are only scanned, never
+ * parsed.
+ *
+ * The shape records what kind of literal each one is: a string, an integer
+ * that fits int4, one that fits int8, or any other number.  Those are the
+ * kinds that can analyze to different types, so "id = 5" and
+ * "id = 5000000000", or "price > 1" and "price > 1.5", are different
+ * shapes.  A literal that still can't be read as its parameter's type
+ * (-2147483648 is an int4, 2147483649 is not) runs the query as written.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_plan_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/tupdesc.h"
+#include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "common/hashfn.h"
+#include "executor/executor.h"
+#include "executor/spi.h"
+#include "lib/stringinfo.h"
+#include "nodes/miscnodes.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/params.h"
+#include "nodes/queryjumble.h"
+#include "parser/analyze.h"
+#include "parser/parser.h"
+#include "parser/scanner.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/plancache.h"
+#include "utils/resowner.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+/* No more parameters than this per query */
+#define PLAN_CACHE_MAX_LITERALS	1024
+
+/* Mark a literal in a shape, by kind; never part of valid SQL */
+#define SHAPE_STRING		'\x01'
+#define SHAPE_INT4			'\x02'
+#define SHAPE_INT8			'\x03'
+#define SHAPE_NUMERIC		'\x04'
+
+/* What became of a literal when its shape was first prepared */
+typedef enum LiteralKind
+{
+	LITERAL_FIXED,				/* kept as written, part of the key */
+	LITERAL_PARAM,				/* replaced by a parameter */
+	LITERAL_NEG_PARAM			/* replaced with its leading minus sign */
+} LiteralKind;
+
+/* A string or numeric literal found by the scanner */
+typedef struct Literal
+{
+	int			start;
+	int			end;
+	int			sign;			/* location of the minus of a negative number */
+	char	   *text;			/* as written */
+	char	   *value;			/* as bound: de-escaped for strings */
+} Literal;
+
+typedef struct ScannedQuery
+{
+	char	   *shape;			/* query with each literal replaced */
+	size_t		shape_len;
+	int			nliterals;
+	Literal	   *literals;
+} ScannedQuery;
+
+typedef struct PlanEntry
+{
+	struct PlanEntry *hash_next;
+	struct PlanEntry *lru_prev;	/* towards most recently used */
+	struct PlanEntry *lru_next;	/* towards least recently used */
+	uint32		hash;
+	char	   *shape;
+	int			nliterals;
+	char	   *kinds;			/* LiteralKind of each literal */
+	char	  **fixed;			/* text of each LITERAL_FIXED literal */
+	int			nparams;
+	Oid		   *param_types;
+	SPIPlanPtr	plan;			/* NULL: run queries of this shape as is */
+} PlanEntry;
+
+static int	cache_max_entries = 0;
+static PlanEntry **cache_buckets = NULL;
+static uint32 cache_nbuckets = 0;
+static PlanEntry *lru_head = NULL;
+static PlanEntry *lru_tail = NULL;
+static pg_plan_cache_stats cache_stats;
+
+bool
+plan_cache_enabled(void)
+{
+	return cache_max_entries > 0;
+}
+
+static void
+lru_unlink(PlanEntry *entry)
+{
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		lru_head = entry->lru_next;
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		lru_tail = entry->lru_prev;
+	entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void
+lru_push_front(PlanEntry *entry)
+{
+	entry->lru_prev = NULL;
+	entry->lru_next = lru_head;
+	if (lru_head)
+		lru_head->lru_prev = entry;
+	lru_head = entry;
+	if (lru_tail == NULL)
+		lru_tail = entry;
+}
+
+static void
+entry_free(PlanEntry *entry, bool free_plan)
+{
+	int			i;
+
+	if (free_plan && entry->plan)
+		SPI_freeplan(entry->plan);
+	for (i = 0; entry->fixed && i < entry->nliterals; i++)
+		host_free(entry->fixed[i]);
+	host_free(entry->fixed);
+	host_free(entry->kinds);
+	host_free(entry->param_types);
+	host_free(entry->shape);
+	host_free(entry);
+}
+
+static void
+entry_remove(PlanEntry *entry)
+{
+	PlanEntry **link = &cache_buckets[entry->hash % cache_nbuckets];
+
+	while (*link != entry)
+		link = &(*link)->hash_next;
+	*link = entry->hash_next;
+
+	lru_unlink(entry);
+	cache_stats.entries--;
+
+	entry_free(entry, true);
+}
+
+/*
+ * drop_all
+ *
+ * Drop every entry.  The plans are only freed when they still exist: after
+ * a reinit they died with the previous instance's memory.
+ */
+static void
+drop_all(bool free_plans)
+{
+	while (lru_head != NULL)
+	{
+		PlanEntry  *entry = lru_head;
+
+		lru_unlink(entry);
+		entry_free(entry, free_plans);
+	}
+	if (cache_buckets)
+		memset(cache_buckets, 0, cache_nbuckets * sizeof(PlanEntry *));
+	cache_stats.entries = 0;
+}
+
+/*
+ * plan_cache_reset
+ *
+ * Called on every pg_embedded_init.  The setting and statistics survive.
+ */
+void
+plan_cache_reset(void)
+{
+	drop_all(false);
+}
+
+/*
+ * pg_embedded_set_plan_cache_size
+ *
+ * Set the maximum number of cached query shapes; 0 disables the cache.
+ */
+void
+pg_embedded_set_plan_cache_size(int max_entries)
+{
+	if (max_entries < 0)
+		max_entries = 0;
+
+	while (lru_tail != NULL && cache_stats.entries > (uint64) max_entries)
+	{
+		entry_remove(lru_tail);
+		cache_stats.evictions++;
+	}
+
+	if (max_entries > 0 && cache_buckets == NULL)
+	{
+		cache_nbuckets = 1024;
+		cache_buckets = host_calloc(cache_nbuckets, sizeof(PlanEntry *));
+		if (!cache_buckets)
+		{
+			cache_nbuckets = 0;
+			max_entries = 0;
+		}
+	}
+
+	cache_max_entries = max_entries;
+}
+
+/* Drop all cached plans */
+void
+pg_embedded_plan_cache_clear(void)
+{
+	drop_all(pg_embedded_is_initialized());
+}
+
+/* Get hit/miss statistics and the current size */
+void
+pg_embedded_plan_cache_stats(pg_plan_cache_stats *stats)
+{
+	if (!stats)
+		return;
+	*stats = cache_stats;
+	stats->max_entries = cache_max_entries;
+}
+
+/* Shape mark of a literal: which type a constant written so can have */
+static char
+literal_shape(const char *text, bool is_string)
+{
+	ErrorSaveContext escontext = {T_ErrorSaveContext};
+
+	if (is_string)
+		return SHAPE_STRING;
+
+	/* 1.5, 1e3 and .5 are numeric, but 0x1E is an integer */
+	if (!(text[0] == '0' && isalpha((unsigned char) text[1])) &&
+		strpbrk(text, ".eE") != NULL)
+		return SHAPE_NUMERIC;
+
+	(void) pg_strtoint32_safe(text, (Node *) &escontext);
+	if (!escontext.error_occurred)
+		return SHAPE_INT4;
+	escontext.error_occurred = false;
+	(void) pg_strtoint64_safe(text, (Node *) &escontext);
+	if (!escontext.error_occurred)
+		return SHAPE_INT8;
+	return SHAPE_NUMERIC;
+}
+
+/*
+ * scan_query
+ *
+ * Find the string and numeric literals of a query with the core scanner
+ * and build its shape.  Returns false if the query can't be parameterized
+ * at all: several statements, or parameters of its own.
+ */
+static bool
+scan_query(const char *query, ScannedQuery *scanned)
+{
+	core_yyscan_t yyscanner;
+	core_yy_extra_type yyextra;
+	core_YYSTYPE yylval;
+	YYLTYPE		yylloc;
+	StringInfoData shape;
+	int			copied = 0;
+	bool		after_semicolon = false;
+	int			alloc = 8;
+
+	scanned->nliterals = 0;
+	scanned->literals = palloc(alloc * sizeof(Literal));
+	initStringInfo(&shape);
+
+	yyscanner = scanner_init(query, &yyextra, &ScanKeywords,
+							 ScanKeywordTokens);
+	yyextra.escape_string_warning = false;
+
+	for (;;)
+	{
+		int			tok = core_yylex(&yylval, &yylloc, yyscanner);
+		const char *text;
+		bool		is_string;
+
+		if (tok == 0)
+			break;
+
+		/* flex NUL-terminates the current token in its buffer */
+		text = yyextra.scanbuf + yylloc;
+
+		if (after_semicolon ||
+			(text[0] == '$' && isdigit((unsigned char) text[1])))
+		{
+			scanner_finish(yyscanner);
+			return false;
+		}
+		if (text[0] == ';' && text[1] == '\0')
+		{
+			after_semicolon = true;
+			continue;
+		}
+
+		is_string = text[0] == '\'' ||
+			((text[0] == 'E' || text[0] == 'e') && text[1] == '\'') ||
+			(text[0] == '$' && !isdigit((unsigned char) text[1]));
+		if (is_string || isdigit((unsigned char) text[0]) ||
+			(text[0] == '.' && isdigit((unsigned char) text[1])))
+		{
+			Literal    *lit;
+
+			if (scanned->nliterals == PLAN_CACHE_MAX_LITERALS)
+			{
+				scanner_finish(yyscanner);
+				return false;
+			}
+			if (scanned->nliterals == alloc)
+			{
+				alloc *= 2;
+				scanned->literals = repalloc(scanned->literals,
+											 alloc * sizeof(Literal));
+			}
+
+			lit = &scanned->literals[scanned->nliterals++];
+			lit->start = yylloc;
+			lit->sign = -1;
+			lit->end = yylloc + strlen(text);
+			lit->text = pnstrdup(query + lit->start, lit->end - lit->start);
+			lit->value = is_string ? pstrdup(yylval.str) : lit->text;
+
+			appendBinaryStringInfo(&shape, query + copied, lit->start - copied);
+			appendStringInfoChar(&shape, literal_shape(lit->text, is_string));
+			copied = lit->end;
+		}
+	}
+	scanner_finish(yyscanner);
+
+	appendStringInfoString(&shape, query + copied);
+	scanned->shape = shape.data;
+	scanned->shape_len = shape.len;
+	return true;
+}
+
+static bool
+entry_matches(PlanEntry *entry, ScannedQuery *scanned, uint32 hash)
+{
+	int			i;
+
+	if (entry->hash != hash || entry->nliterals != scanned->nliterals ||
+		strcmp(entry->shape, scanned->shape) != 0)
+		return false;
+
+	for (i = 0; i < entry->nliterals; i++)
+	{
+		if (entry->kinds[i] == LITERAL_FIXED &&
+			strcmp(entry->fixed[i], scanned->literals[i].text) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/* Consts of an analyzed query, by location */
+typedef struct ConstInfo
+{
+	int			location;
+	Oid			type;
+} ConstInfo;
+
+typedef struct ConstCollector
+{
+	ConstInfo  *consts;
+	int			count;
+	int			alloc;
+} ConstCollector;
+
+static bool
+collect_consts_walker(Node *node, ConstCollector *collector)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Const))
+	{
+		Const	   *con = (Const *) node;
+
+		if (con->location >= 0)
+		{
+			if (collector->count == collector->alloc)
+			{
+				collector->alloc *= 2;
+				collector->consts = repalloc(collector->consts,
+											 collector->alloc * sizeof(ConstInfo));
+			}
+			collector->consts[collector->count].location = con->location;
+			collector->consts[collector->count].type = con->consttype;
+			collector->count++;
+		}
+		return false;
+	}
+	if (IsA(node, Query))
+		return query_tree_walker((Query *) node, collect_consts_walker,
+								 collector, 0);
+	return expression_tree_walker(node, collect_consts_walker, collector);
+}
+
+static Oid
+const_type_at(ConstCollector *collector, int location)
+{
+	int			i;
+
+	for (i = 0; i < collector->count; i++)
+	{
+		if (collector->consts[i].location == location)
+			return collector->consts[i].type;
+	}
+	return InvalidOid;
+}
+
+/*
+ * classify_literals
+ *
+ * Analyze and jumble the query, and mark the literals at the jumble's
+ * constant locations as parameters.  Analysis errors are the query's own
+ * and are thrown as they would be by SPI_execute().  Returns false if the
+ * statement is of a kind that takes no parameters.
+ */
+static bool
+classify_literals(const char *query, ScannedQuery *scanned, char *kinds,
+				  Oid *types, Query **analyzed)
+{
+	List	   *raw;
+	RawStmt    *rawstmt;
+	JumbleState *jstate;
+	ConstCollector collector;
+	int			i;
+
+	raw = raw_parser(query, RAW_PARSE_DEFAULT);
+	if (list_length(raw) != 1)
+		return false;
+	rawstmt = linitial_node(RawStmt, raw);
+	if (!IsA(rawstmt->stmt, SelectStmt) && !IsA(rawstmt->stmt, InsertStmt) &&
+		!IsA(rawstmt->stmt, UpdateStmt) && !IsA(rawstmt->stmt, DeleteStmt) &&
+		!IsA(rawstmt->stmt, MergeStmt))
+		return false;
+
+	*analyzed = parse_analyze_fixedparams(rawstmt, query, NULL, 0, NULL);
+	jstate = JumbleQuery(*analyzed);
+
+	collector.count = 0;
+	collector.alloc = 16;
+	collector.consts = palloc(collector.alloc * sizeof(ConstInfo));
+	collect_consts_walker((Node *) *analyzed, &collector);
+
+	for (i = 0; i < jstate->clocations_count; i++)
+	{
+		LocationLen *loc = &jstate->clocations[i];
+		Oid			type;
+		int			j;
+
+		/* A squashed IN list is one location for many constants */
+		if (loc->squashed)
+			continue;
+		type = const_type_at(&collector, loc->location);
+		if (!OidIsValid(type) || type == UNKNOWNOID)
+			continue;
+
+		for (j = 0; j < scanned->nliterals; j++)
+		{
+			Literal    *lit = &scanned->literals[j];
+
+			if (lit->start == loc->location)
+			{
+				kinds[j] = LITERAL_PARAM;
+				types[j] = type;
+				break;
+			}
+
+			/* A negative number's location is that of its minus sign */
+			if (lit->start > loc->location && query[loc->location] == '-' &&
+				lit->value == lit->text &&
+				strspn(query + loc->location + 1, " \t\r\n\f") ==
+				lit->start - loc->location - 1)
+			{
+				kinds[j] = LITERAL_NEG_PARAM;
+				types[j] = type;
+				lit->sign = loc->location;
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+ * result_types_match
+ *
+ * Does the parameterized plan return the same column types as the query
+ * as written?  A parameter can resolve an expression differently than its
+ * literal did.
+ */
+static bool
+result_types_match(SPIPlanPtr plan, Query *analyzed)
+{
+	List	   *sources = SPI_plan_get_plan_sources(plan);
+	CachedPlanSource *plansource;
+	List	   *tlist;
+	TupleDesc	expected;
+
+	if (list_length(sources) != 1)
+		return false;
+	plansource = linitial(sources);
+
+	tlist = analyzed->commandType == CMD_SELECT ? analyzed->targetList :
+		analyzed->returningList;
+	if (tlist == NIL)
+		return plansource->resultDesc == NULL;
+	if (plansource->resultDesc == NULL)
+		return false;
+
+	expected = ExecCleanTypeFromTL(tlist);
+	return equalRowTypes(expected, plansource->resultDesc);
+}
+
+/*
+ * entry_build
+ *
+ * Decide which literals of a new shape become parameters and prepare the
+ * parameterized query.  Returns NULL if out of memory.
+ */
+static PlanEntry *
+entry_build(const char *query, ScannedQuery *scanned, uint32 hash)
+{
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	PlanEntry  *entry;
+	Query	   *analyzed = NULL;
+	char	   *kinds;
+	Oid		   *types;
+	Oid		   *param_types;
+	StringInfoData sql;
+	SPIPlanPtr	plan = NULL;
+	int			nparams = 0;
+	int			copied = 0;
+	int			i;
+
+	kinds = palloc0(Max(scanned->nliterals, 1));
+	types = palloc0(Max(scanned->nliterals, 1) * sizeof(Oid));
+	param_types = palloc(Max(scanned->nliterals, 1) * sizeof(Oid));
+
+	if (classify_literals(query, scanned, kinds, types, &analyzed))
+	{
+		/* The query text with its chosen literals replaced by $n */
+		initStringInfo(&sql);
+		for (i = 0; i < scanned->nliterals; i++)
+		{
+			Literal    *lit = &scanned->literals[i];
+			int			start = lit->start;
+
+			if (kinds[i] == LITERAL_FIXED)
+				continue;
+			if (kinds[i] == LITERAL_NEG_PARAM)
+				start = lit->sign;
+			appendBinaryStringInfo(&sql, query + copied, start - copied);
+			param_types[nparams++] = types[i];
+			appendStringInfo(&sql, "$%d", nparams);
+			copied = lit->end;
+		}
+		appendStringInfoString(&sql, query + copied);
+
+		/* A failure only means this shape runs as written */
+		BeginInternalSubTransaction(NULL);
+		MemoryContextSwitchTo(oldcxt);
+		PG_TRY();
+		{
+			plan = SPI_prepare(sql.data, nparams, param_types);
+			if (plan != NULL && !result_types_match(plan, analyzed))
+				plan = NULL;
+			if (plan != NULL)
+				SPI_keepplan(plan);
+
+			ReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(oldcxt);
+			CurrentResourceOwner = oldowner;
+		}
+		PG_CATCH();
+		{
+			MemoryContextSwitchTo(oldcxt);
+			FlushErrorState();
+
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(oldcxt);
+			CurrentResourceOwner = oldowner;
+			plan = NULL;
+		}
+		PG_END_TRY();
+	}
+
+	entry = host_calloc(1, sizeof(PlanEntry));
+	if (!entry)
+		goto oom;
+	entry->hash = hash;
+	entry->nliterals = scanned->nliterals;
+	entry->shape = host_strdup(scanned->shape);
+	entry->kinds = host_malloc(Max(scanned->nliterals, 1));
+	entry->fixed = host_calloc(Max(scanned->nliterals, 1), sizeof(char *));
+	entry->param_types = host_malloc(Max(nparams, 1) * sizeof(Oid));
+	if (!entry->shape || !entry->kinds || !entry->fixed || !entry->param_types)
+		goto oom;
+
+	entry->plan = plan;
+	if (plan != NULL)
+	{
+		entry->nparams = nparams;
+		memcpy(entry->param_types, param_types, nparams * sizeof(Oid));
+		memcpy(entry->kinds, kinds, scanned->nliterals);
+		for (i = 0; i < scanned->nliterals; i++)
+		{
+			if (kinds[i] == LITERAL_FIXED &&
+				!(entry->fixed[i] = host_strdup(scanned->literals[i].text)))
+				goto oom;
+		}
+	}
+	else
+	{
+		/* Every query of this shape runs as is, whatever its literals */
+		memset(entry->kinds, LITERAL_PARAM, scanned->nliterals);
+	}
+
+	return entry;
+
+oom:
+	if (entry)
+	{
+		entry->plan = plan;
+		entry_free(entry, true);
+	}
+	else if (plan)
+		SPI_freeplan(plan);
+	return NULL;
+}
+
+/*
+ * bind_literals
+ *
+ * Convert the literals of this query into the parameter values of a cached
+ * plan.  Returns false if one is not a valid value of its parameter's type.
+ */
+static bool
+bind_literals(PlanEntry *entry, ScannedQuery *scanned, ParamListInfo *paramsp)
+{
+	ParamListInfo params = NULL;
+	int			n = 0;
+	int			i;
+
+	if (entry->nparams > 0)
+		params = makeParamList(entry->nparams);
+
+	for (i = 0; i < entry->nliterals; i++)
+	{
+		ParamExternData *prm;
+		const char *value = scanned->literals[i].value;
+		ErrorSaveContext escontext = {T_ErrorSaveContext};
+		FmgrInfo	flinfo;
+		Oid			typinput;
+		Oid			typioparam;
+
+		if (entry->kinds[i] == LITERAL_FIXED)
+			continue;
+		if (entry->kinds[i] == LITERAL_NEG_PARAM)
+			value = psprintf("-%s", value);
+
+		prm = &params->params[n];
+		getTypeInputInfo(entry->param_types[n], &typinput, &typioparam);
+		prm->ptype = entry->param_types[n];
+		prm->pflags = PARAM_FLAG_CONST;
+		prm->isnull = false;
+		fmgr_info(typinput, &flinfo);
+		if (!InputFunctionCallSafe(&flinfo, (char *) value, typioparam, -1,
+								   (Node *) &escontext, &prm->value))
+			return false;
+		n++;
+	}
+
+	*paramsp = params;
+	return true;
+}
+
+/*
+ * plan_cache_execute
+ *
+ * Execute a query through the plan cache, inside the SPI connection of
+ * pg_embedded_exec().  Returns what SPI_execute() would.
+ */
+int
+plan_cache_execute(const char *query)
+{
+	ScannedQuery scanned;
+	PlanEntry  *entry;
+	uint32		hash;
+	ParamListInfo params;
+	bool		found;
+
+	if (IsAbortedTransactionBlockState() || !scan_query(query, &scanned))
+		return SPI_execute(query, false, 0);
+
+	hash = hash_bytes((const unsigned char *) scanned.shape, scanned.shape_len);
+	for (entry = cache_buckets[hash % cache_nbuckets]; entry != NULL;
+		 entry = entry->hash_next)
+	{
+		if (entry_matches(entry, &scanned, hash))
+			break;
+	}
+
+	found = entry != NULL;
+	if (found)
+	{
+		lru_unlink(entry);
+		lru_push_front(entry);
+	}
+	else
+	{
+		entry = entry_build(query, &scanned, hash);
+		if (entry == NULL)
+			return SPI_execute(query, false, 0);
+
+		if (cache_stats.entries >= (uint64) cache_max_entries && lru_tail)
+		{
+			entry_remove(lru_tail);
+			cache_stats.evictions++;
+		}
+		entry->hash_next = cache_buckets[hash % cache_nbuckets];
+		cache_buckets[hash % cache_nbuckets] = entry;
+		lru_push_front(entry);
+		cache_stats.entries++;
+	}
+
+	if (entry->plan == NULL || !bind_literals(entry, &scanned, &params))
+	{
+		cache_stats.uncacheable++;
+		return SPI_execute(query, false, 0);
+	}
+
+	if (found)
+		cache_stats.hits++;
+	else
+		cache_stats.misses++;
+	return SPI_execute_plan_with_paramlist(entry->plan, params, false, 0);
+}
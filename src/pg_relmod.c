@@ -0,0 +1,369 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_relmod.c
+ *	  Per-relation modification counters for the PostgreSQL Embedded API
+ *
+ * Relations written by the executor (including partitions reached through
+ * tuple routing and writes done by triggers), COPY FROM, TRUNCATE and
+ * REFRESH MATERIALIZED VIEW are remembered for the current transaction and
+ * their counters are bumped when it commits; an abort just forgets them.
+ * Relcache invalidations bump the counters immediately, so DDL and anything
+ * else that changes a relation's definition is seen as a modification too.
+ *
+ * There is only one backend, so these counters see every change made to
+ * the database.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_relmod.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "pg_relmod.h"
+
+#include "access/xact.h"
+#include "catalog/namespace.h"
+#include "catalog/partition.h"
+#include "catalog/pg_inherits.h"
+#include "executor/executor.h"
+#include "nodes/parsenodes.h"
+#include "tcop/utility.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+typedef struct RelModEntry
+{
+	Oid			relid;			/* hash key */
+	uint64		mod_count;
+	uint64		ddl_count;
+} RelModEntry;
+
+/* Committed counters, in TopMemoryContext */
+static HTAB *relmod_counts = NULL;
+
+/* Relations modified by the current transaction, in TopTransactionContext */
+static HTAB *relmod_pending = NULL;
+
+static uint64 relmod_epoch = 0;
+
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+static ProcessUtility_hook_type prev_ProcessUtility = NULL;
+
+static void relmod_ExecutorEnd(QueryDesc *queryDesc);
+static void relmod_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
+								  bool readOnlyTree,
+								  ProcessUtilityContext context,
+								  ParamListInfo params,
+								  QueryEnvironment *queryEnv,
+								  DestReceiver *dest, QueryCompletion *qc);
+static void relmod_xact_callback(XactEvent event, void *arg);
+static void relmod_relcache_callback(Datum arg, Oid relid);
+
+/*
+ * pg_relmod_init
+ *
+ * Called right after the memory context system is up, before anything can
+ * send a relcache invalidation.  The hooks and the relcache callback live
+ * in static memory and are only installed once per process.  The counter
+ * table and the transaction callback are allocated in TopMemoryContext, so
+ * they are created again on every initialization.
+ */
+void
+pg_relmod_init(void)
+{
+	static bool hooks_installed = false;
+	HASHCTL		ctl;
+
+	if (!hooks_installed)
+	{
+		prev_ExecutorEnd = ExecutorEnd_hook;
+		ExecutorEnd_hook = relmod_ExecutorEnd;
+		prev_ProcessUtility = ProcessUtility_hook;
+		ProcessUtility_hook = relmod_ProcessUtility;
+		CacheRegisterRelcacheCallback(relmod_relcache_callback, (Datum) 0);
+		hooks_installed = true;
+	}
+
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(RelModEntry);
+	relmod_counts = hash_create("embedded relation counters", 256, &ctl,
+								HASH_ELEM | HASH_BLOBS);
+	relmod_pending = NULL;
+
+	/* Counters restart at zero, so nothing saved before is comparable */
+	relmod_epoch++;
+
+	RegisterXactCallback(relmod_xact_callback, NULL);
+}
+
+uint64
+pg_relmod_epoch(void)
+{
+	return relmod_epoch;
+}
+
+uint64
+pg_relmod_count(Oid relid)
+{
+	RelModEntry *entry;
+
+	if (relmod_counts == NULL)
+		return 0;
+
+	entry = hash_search(relmod_counts, &relid, HASH_FIND, NULL);
+	return entry ? entry->mod_count : 0;
+}
+
+uint64
+pg_relmod_ddl_count(Oid relid)
+{
+	RelModEntry *entry;
+
+	if (relmod_counts == NULL)
+		return 0;
+
+	entry = hash_search(relmod_counts, &relid, HASH_FIND, NULL);
+	return entry ? entry->ddl_count : 0;
+}
+
+bool
+pg_relmod_pending(void)
+{
+	return relmod_pending != NULL && hash_get_num_entries(relmod_pending) > 0;
+}
+
+static RelModEntry *
+relmod_entry(Oid relid)
+{
+	RelModEntry *entry;
+	bool		found;
+
+	entry = hash_search(relmod_counts, &relid, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->mod_count = 0;
+		entry->ddl_count = 0;
+	}
+	return entry;
+}
+
+/*
+ * relmod_mark
+ *
+ * Remember that the current transaction modified a relation.  A write to a
+ * partition changes what its partitioned ancestors return as well.
+ */
+static void
+relmod_mark(Oid relid)
+{
+	bool		found;
+
+	if (!OidIsValid(relid) || relmod_counts == NULL)
+		return;
+
+	if (relmod_pending == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(Oid);
+		ctl.hcxt = TopTransactionContext;
+		relmod_pending = hash_create("embedded pending relation changes", 16,
+									 &ctl, HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	(void) hash_search(relmod_pending, &relid, HASH_ENTER, &found);
+
+	if (!found && get_rel_relispartition(relid))
+	{
+		List	   *ancestors = get_partition_ancestors(relid);
+		ListCell   *lc;
+
+		foreach(lc, ancestors)
+			(void) hash_search(relmod_pending, &lfirst_oid(lc), HASH_ENTER, NULL);
+		list_free(ancestors);
+	}
+}
+
+/*
+ * relmod_mark_tree
+ *
+ * Mark a relation and, for partitioned tables, everything below it; used
+ * where we don't know which partitions were actually touched.
+ */
+static void
+relmod_mark_tree(Oid relid)
+{
+	List	   *relids;
+	ListCell   *lc;
+
+	if (!OidIsValid(relid))
+		return;
+
+	relids = find_all_inheritors(relid, NoLock, NULL);
+	foreach(lc, relids)
+		relmod_mark(lfirst_oid(lc));
+	list_free(relids);
+}
+
+static void
+relmod_mark_result_rels(List *resultRelInfos)
+{
+	ListCell   *lc;
+
+	foreach(lc, resultRelInfos)
+	{
+		ResultRelInfo *rri = (ResultRelInfo *) lfirst(lc);
+
+		relmod_mark(RelationGetRelid(rri->ri_RelationDesc));
+	}
+}
+
+/*
+ * relmod_ExecutorEnd
+ *
+ * Every relation opened as a result relation may have been written; that
+ * covers data-modifying CTEs as well.  es_tuple_routing_result_relations
+ * holds the partitions rows were routed to, which are not part of the range
+ * table.
+ */
+static void
+relmod_ExecutorEnd(QueryDesc *queryDesc)
+{
+	EState	   *estate = queryDesc->estate;
+
+	if (estate != NULL)
+	{
+		relmod_mark_result_rels(estate->es_opened_result_relations);
+		relmod_mark_result_rels(estate->es_tuple_routing_result_relations);
+	}
+
+	if (prev_ExecutorEnd)
+		prev_ExecutorEnd(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+}
+
+/*
+ * relmod_ProcessUtility
+ *
+ * Utility commands that change table contents without going through the
+ * executor.  They are marked after they succeed; a failure aborts the
+ * transaction anyway.
+ */
+static void
+relmod_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
+					  bool readOnlyTree, ProcessUtilityContext context,
+					  ParamListInfo params, QueryEnvironment *queryEnv,
+					  DestReceiver *dest, QueryCompletion *qc)
+{
+	Node	   *parsetree = pstmt->utilityStmt;
+
+	if (prev_ProcessUtility)
+		prev_ProcessUtility(pstmt, queryString, readOnlyTree, context,
+							params, queryEnv, dest, qc);
+	else
+		standard_ProcessUtility(pstmt, queryString, readOnlyTree, context,
+								params, queryEnv, dest, qc);
+
+	switch (nodeTag(parsetree))
+	{
+		case T_TruncateStmt:
+			{
+				TruncateStmt *stmt = (TruncateStmt *) parsetree;
+				ListCell   *lc;
+
+				/* CASCADE'd tables get a relcache invalidation of their own */
+				foreach(lc, stmt->relations)
+					relmod_mark_tree(RangeVarGetRelid(lfirst_node(RangeVar, lc),
+													  NoLock, true));
+			}
+			break;
+
+		case T_CopyStmt:
+			{
+				CopyStmt   *stmt = (CopyStmt *) parsetree;
+
+				if (stmt->is_from && stmt->relation)
+					relmod_mark_tree(RangeVarGetRelid(stmt->relation, NoLock,
+													  true));
+			}
+			break;
+
+		case T_RefreshMatViewStmt:
+			relmod_mark(RangeVarGetRelid(((RefreshMatViewStmt *) parsetree)->relation,
+										 NoLock, true));
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * relmod_xact_callback
+ *
+ * Publish the pending changes on commit.  The pending table itself lives in
+ * TopTransactionContext and goes away with the transaction either way.
+ */
+static void
+relmod_xact_callback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+			if (relmod_pending != NULL)
+			{
+				HASH_SEQ_STATUS status;
+				Oid		   *relid;
+
+				hash_seq_init(&status, relmod_pending);
+				while ((relid = hash_seq_search(&status)) != NULL)
+					relmod_entry(*relid)->mod_count++;
+			}
+			relmod_pending = NULL;
+			break;
+
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+		case XACT_EVENT_PREPARE:
+			relmod_pending = NULL;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * relmod_relcache_callback
+ *
+ * Definition changes are counted right away: an uncommitted ALTER can
+ * already change what a query run in the same transaction sees.
+ */
+static void
+relmod_relcache_callback(Datum arg, Oid relid)
+{
+	RelModEntry *entry;
+
+	if (relmod_counts == NULL)
+		return;
+
+	if (!OidIsValid(relid))
+	{
+		/* Full reset: treat everything as changed */
+		relmod_epoch++;
+		return;
+	}
+
+	entry = relmod_entry(relid);
+	entry->mod_count++;
+	entry->ddl_count++;
+}
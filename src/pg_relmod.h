@@ -0,0 +1,37 @@
+/*
+ * pg_relmod.h
+ *   Per-relation modification counters for the embedded API
+ *
+ * Every committed transaction that changed the contents of a relation
+ * (INSERT/UPDATE/DELETE/MERGE, COPY FROM, TRUNCATE, REFRESH MATERIALIZED
+ * VIEW) bumps that relation's counter.  Relcache invalidations (DDL, or
+ * anything else that changes the relation's definition) bump both the
+ * modification and the DDL counter.  Anything that caches results or plans
+ * derived from a relation can remember the counters it saw and compare
+ * them later.
+ */
+
+#ifndef PG_RELMOD_H
+#define PG_RELMOD_H
+
+#include "postgres.h"
+
+/* Set up the counter table; called from pg_embedded_init */
+extern void pg_relmod_init(void);
+
+/*
+ * Bumped whenever all counters must be considered changed (a full relcache
+ * reset, or a new pg_embedded_init).  Include it in any saved snapshot.
+ */
+extern uint64 pg_relmod_epoch(void);
+
+/* Committed data or definition changes of a relation */
+extern uint64 pg_relmod_count(Oid relid);
+
+/* Committed definition changes (relcache invalidations) of a relation */
+extern uint64 pg_relmod_ddl_count(Oid relid);
+
+/* Has the current transaction modified anything not yet committed? */
+extern bool pg_relmod_pending(void);
+
+#endif /* PG_RELMOD_H */
@@ -0,0 +1,623 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_result_cache.c
+ *	  Query result cache for the PostgreSQL Embedded API
+ *
+ * When enabled with pg_embedded_set_result_cache_size(), pg_embedded_exec()
+ * keeps the results of plain read-only SELECTs in a byte-bounded LRU cache.
+ * An entry is keyed by the query text plus everything that can change what
+ * the same text returns as strings (current user, search_path, date/time
+ * and number output settings), and remembers the pg_relmod counters of
+ * every relation in its plan.  It is served as long as none of those
+ * relations was modified or redefined; a changed entry is dropped on
+ * lookup.
+ *
+ * Queries that depend on anything else are never cached: volatile or
+ * stable functions (now(), random(), functions reading tables), row
+ * locks, data-modifying CTEs and system catalogs.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_result_cache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+#include "pg_relmod.h"
+
+#include "access/transam.h"
+#include "access/xact.h"
+#include "catalog/pg_class.h"
+#include "common/hashfn.h"
+#include "executor/spi.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "nodes/parsenodes.h"
+#include "optimizer/optimizer.h"
+#include "parser/parser.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/plancache.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+typedef struct CacheEntry
+{
+	struct CacheEntry *hash_next;
+	struct CacheEntry *lru_prev;	/* towards most recently used */
+	struct CacheEntry *lru_next;	/* towards least recently used */
+	uint32		hash;
+	char	   *key;
+	pg_result  *result;
+	size_t		bytes;
+	uint64		epoch;
+	int			ndeps;
+	Oid		   *dep_relids;
+	uint64	   *dep_counts;
+} CacheEntry;
+
+/* Settings that change the text of a result without changing the query */
+static const char *const result_cache_gucs[] = {
+	"search_path",
+	"DateStyle",
+	"IntervalStyle",
+	"TimeZone",
+	"extra_float_digits",
+	"bytea_output",
+	"lc_monetary",
+	"lc_numeric",
+	"row_security",
+	NULL
+};
+
+static size_t cache_max_bytes = 0;
+static size_t cache_bytes = 0;
+static uint64 cache_entries = 0;
+static CacheEntry **cache_buckets = NULL;
+static uint32 cache_nbuckets = 0;
+static CacheEntry *lru_head = NULL;
+static CacheEntry *lru_tail = NULL;
+static pg_result_cache_stats cache_stats;
+
+/* Dependencies of the last query run by result_cache_execute() */
+static int	pending_ndeps = 0;
+static Oid *pending_relids = NULL;
+
+bool
+result_cache_enabled(void)
+{
+	return cache_max_bytes > 0;
+}
+
+static void
+lru_unlink(CacheEntry *entry)
+{
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		lru_head = entry->lru_next;
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		lru_tail = entry->lru_prev;
+	entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void
+lru_push_front(CacheEntry *entry)
+{
+	entry->lru_prev = NULL;
+	entry->lru_next = lru_head;
+	if (lru_head)
+		lru_head->lru_prev = entry;
+	lru_head = entry;
+	if (lru_tail == NULL)
+		lru_tail = entry;
+}
+
+static void
+entry_free(CacheEntry *entry)
+{
+	pg_embedded_free_result(entry->result);
+	host_free(entry->dep_relids);
+	host_free(entry->dep_counts);
+	host_free(entry->key);
+	host_free(entry);
+}
+
+static void
+entry_remove(CacheEntry *entry)
+{
+	CacheEntry **link = &cache_buckets[entry->hash % cache_nbuckets];
+
+	while (*link != entry)
+		link = &(*link)->hash_next;
+	*link = entry->hash_next;
+
+	lru_unlink(entry);
+	cache_bytes -= entry->bytes;
+	cache_entries--;
+
+	entry_free(entry);
+}
+
+static void
+evict_to(size_t max_bytes)
+{
+	while (lru_tail != NULL && cache_bytes > max_bytes)
+	{
+		entry_remove(lru_tail);
+		cache_stats.evictions++;
+	}
+}
+
+/*
+ * copy_result
+ *
+ * Deep-copy a pg_result; returns NULL if out of memory.
+ */
+static pg_result *
+copy_result(const pg_result *src)
+{
+	pg_result  *result = host_calloc(1, sizeof(pg_result));
+	uint64_t	row;
+	int			col;
+
+	if (!result)
+		return NULL;
+
+	result->status = src->status;
+	result->cols = src->cols;
+	if (src->colnames)
+	{
+		result->colnames = host_calloc(Max(src->cols, 1), sizeof(char *));
+		if (!result->colnames)
+			goto oom;
+		for (col = 0; col < src->cols; col++)
+		{
+			if (src->colnames[col] &&
+				!(result->colnames[col] = host_strdup(src->colnames[col])))
+				goto oom;
+		}
+	}
+	if (src->values)
+	{
+		result->values = host_calloc(Max(src->rows, 1), sizeof(char **));
+		if (!result->values)
+			goto oom;
+	}
+	result->rows = src->rows;
+	for (row = 0; src->values && row < src->rows; row++)
+	{
+		result->values[row] = host_calloc(Max(src->cols, 1), sizeof(char *));
+		if (!result->values[row])
+			goto oom;
+		for (col = 0; col < src->cols; col++)
+		{
+			if (src->values[row][col] &&
+				!(result->values[row][col] = host_strdup(src->values[row][col])))
+				goto oom;
+		}
+	}
+
+	return result;
+
+oom:
+	pg_embedded_free_result(result);
+	return NULL;
+}
+
+static size_t
+result_bytes(const pg_result *result)
+{
+	size_t		bytes = sizeof(pg_result);
+	uint64_t	row;
+	int			col;
+
+	bytes += result->cols * sizeof(char *);
+	for (col = 0; col < result->cols; col++)
+		bytes += result->colnames[col] ? strlen(result->colnames[col]) + 1 : 0;
+
+	for (row = 0; row < result->rows; row++)
+	{
+		bytes += sizeof(char **) + result->cols * sizeof(char *);
+		for (col = 0; col < result->cols; col++)
+		{
+			const char *value = result->values[row][col];
+
+			bytes += value ? strlen(value) + 1 : 0;
+		}
+	}
+
+	return bytes;
+}
+
+/*
+ * make_key
+ *
+ * The cache key: query text, user and the output-affecting settings,
+ * separated by NUL bytes that can't appear in any of them.  Returns a
+ * malloc'd string of *len bytes.
+ */
+static char *
+make_key(const char *query, size_t *len)
+{
+	StringInfoData buf;
+	char	   *key;
+	int			i;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, query);
+	appendStringInfoChar(&buf, '\0');
+	appendStringInfo(&buf, "%u", GetUserId());
+	for (i = 0; result_cache_gucs[i] != NULL; i++)
+	{
+		const char *value = GetConfigOption(result_cache_gucs[i], true, false);
+
+		appendStringInfoChar(&buf, '\0');
+		appendStringInfoString(&buf, value ? value : "");
+	}
+
+	key = host_malloc(buf.len + 1);
+	if (key)
+		memcpy(key, buf.data, buf.len + 1);
+	*len = buf.len;
+	pfree(buf.data);
+
+	return key;
+}
+
+/* Keys are stored with their length in front */
+static bool
+key_equal(const char *stored, const char *key, size_t len)
+{
+	size_t		stored_len;
+
+	memcpy(&stored_len, stored, sizeof(size_t));
+	return stored_len == len && memcmp(stored + sizeof(size_t), key, len) == 0;
+}
+
+static bool
+entry_valid(CacheEntry *entry)
+{
+	int			i;
+
+	if (entry->epoch != pg_relmod_epoch())
+		return false;
+
+	for (i = 0; i < entry->ndeps; i++)
+	{
+		if (pg_relmod_count(entry->dep_relids[i]) != entry->dep_counts[i])
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * result_cache_lookup
+ *
+ * Return a copy of the cached result of a query, or NULL on a miss.  On a
+ * miss, *key_out is set to the entry key (or NULL if the query can't be
+ * cached right now) to be passed on to result_cache_store().
+ */
+pg_result *
+result_cache_lookup(const char *query, char **key_out)
+{
+	MemoryContext oldcxt;
+	CacheEntry *entry;
+	pg_result  *result;
+	char	   *key;
+	size_t		len;
+	uint32		hash;
+
+	*key_out = NULL;
+
+	/*
+	 * Uncommitted changes of the current transaction are not reflected in
+	 * the counters, and an aborted transaction must keep failing.
+	 */
+	if (!result_cache_enabled() || pg_relmod_pending() ||
+		IsAbortedTransactionBlockState())
+		return NULL;
+
+	/* Outside a transaction CurrentMemoryContext may be anything */
+	oldcxt = MemoryContextSwitchTo(MessageContext);
+	key = make_key(query, &len);
+	MemoryContextSwitchTo(oldcxt);
+	if (!key)
+		return NULL;
+	hash = hash_bytes((const unsigned char *) key, len);
+
+	if (cache_nbuckets > 0)
+	{
+		for (entry = cache_buckets[hash % cache_nbuckets]; entry != NULL;
+			 entry = entry->hash_next)
+		{
+			if (entry->hash != hash || !key_equal(entry->key, key, len))
+				continue;
+
+			if (!entry_valid(entry))
+			{
+				entry_remove(entry);
+				cache_stats.invalidations++;
+				break;
+			}
+
+			result = copy_result(entry->result);
+			if (result == NULL)
+				break;
+			lru_unlink(entry);
+			lru_push_front(entry);
+			cache_stats.hits++;
+			host_free(key);
+			return result;
+		}
+	}
+
+	/* Store the key with its length, ready for result_cache_store() */
+	*key_out = host_malloc(sizeof(size_t) + len + 1);
+	if (*key_out)
+	{
+		memcpy(*key_out, &len, sizeof(size_t));
+		memcpy(*key_out + sizeof(size_t), key, len + 1);
+	}
+	host_free(key);
+	cache_stats.misses++;
+
+	return NULL;
+}
+
+/*
+ * plan_cacheable
+ *
+ * A plan qualifies if it is a single plain SELECT without volatile or
+ * stable functions, row locks or writes, reading only user relations.
+ * Sequences don't qualify: nextval() and setval() change them without
+ * pg_relmod counting it.
+ */
+static bool
+plan_cacheable(SPIPlanPtr plan)
+{
+	List	   *sources = SPI_plan_get_plan_sources(plan);
+	CachedPlanSource *plansource;
+	ListCell   *lc;
+
+	if (list_length(sources) != 1)
+		return false;
+
+	plansource = linitial(sources);
+	if (plansource->commandTag != CMDTAG_SELECT)
+		return false;
+
+	foreach(lc, plansource->query_list)
+	{
+		Query	   *query = lfirst_node(Query, lc);
+
+		if (query->commandType != CMD_SELECT || query->utilityStmt != NULL ||
+			query->rowMarks != NIL || query->hasModifyingCTE)
+			return false;
+		if (contain_mutable_functions((Node *) query))
+			return false;
+	}
+
+	/* Catalog changes are not counted by pg_relmod */
+	foreach(lc, plansource->relationOids)
+	{
+		if (lfirst_oid(lc) < FirstNormalObjectId ||
+			get_rel_relkind(lfirst_oid(lc)) == RELKIND_SEQUENCE)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * result_cache_execute
+ *
+ * Run a query through SPI like SPI_execute(query, false, 0) would, but plan
+ * it first when it looks like a single SELECT so its cacheability and
+ * dependencies are known.  *cacheable tells whether the result may be
+ * passed to result_cache_store().
+ */
+int
+result_cache_execute(const char *query, bool *cacheable)
+{
+	List	   *raw;
+	SPIPlanPtr	plan;
+	CachedPlanSource *plansource;
+	ListCell   *lc;
+	int			ret;
+	int			i;
+
+	*cacheable = false;
+
+	/*
+	 * Multi-statement strings must keep SPI_execute's statement-at-a-time
+	 * analysis, so only a lone SELECT is planned up front.
+	 */
+	raw = raw_parser(query, RAW_PARSE_DEFAULT);
+	if (list_length(raw) != 1 ||
+		!IsA(linitial_node(RawStmt, raw)->stmt, SelectStmt) ||
+		((SelectStmt *) linitial_node(RawStmt, raw)->stmt)->intoClause != NULL)
+	{
+		cache_stats.uncacheable++;
+		return SPI_execute(query, false, 0);
+	}
+
+	plan = SPI_prepare(query, 0, NULL);
+	if (plan == NULL)
+		elog(ERROR, "%s", SPI_result_code_string(SPI_result));
+
+	ret = SPI_execute_plan(plan, NULL, NULL, false, 0);
+	if (ret != SPI_OK_SELECT || !plan_cacheable(plan))
+	{
+		cache_stats.uncacheable++;
+		return ret;
+	}
+
+	/* Read after execution: execution may have replanned */
+	plansource = linitial(SPI_plan_get_plan_sources(plan));
+	host_free(pending_relids);
+	pending_ndeps = list_length(plansource->relationOids);
+	pending_relids = host_malloc(Max(pending_ndeps, 1) * sizeof(Oid));
+	if (!pending_relids)
+		return ret;
+	i = 0;
+	foreach(lc, plansource->relationOids)
+		pending_relids[i++] = lfirst_oid(lc);
+
+	*cacheable = true;
+	return ret;
+}
+
+static void
+buckets_grow(void)
+{
+	uint32		nbuckets = cache_nbuckets ? cache_nbuckets * 2 : 256;
+	CacheEntry **buckets = host_calloc(nbuckets, sizeof(CacheEntry *));
+	uint32		i;
+
+	if (!buckets)
+		return;
+
+	for (i = 0; i < cache_nbuckets; i++)
+	{
+		CacheEntry *entry = cache_buckets[i];
+
+		while (entry != NULL)
+		{
+			CacheEntry *next = entry->hash_next;
+
+			entry->hash_next = buckets[entry->hash % nbuckets];
+			buckets[entry->hash % nbuckets] = entry;
+			entry = next;
+		}
+	}
+
+	host_free(cache_buckets);
+	cache_buckets = buckets;
+	cache_nbuckets = nbuckets;
+}
+
+/*
+ * result_cache_store
+ *
+ * Remember the result of the query last run by result_cache_execute().
+ * Takes ownership of key.
+ */
+void
+result_cache_store(char *key, const pg_result *result)
+{
+	CacheEntry *entry;
+	size_t		len;
+	int			i;
+
+	if (!result_cache_enabled() || pending_relids == NULL)
+	{
+		host_free(key);
+		return;
+	}
+
+	memcpy(&len, key, sizeof(size_t));
+
+	entry = host_calloc(1, sizeof(CacheEntry));
+	if (!entry)
+	{
+		host_free(key);
+		return;
+	}
+	entry->key = key;
+	entry->hash = hash_bytes((const unsigned char *) key + sizeof(size_t), len);
+	entry->epoch = pg_relmod_epoch();
+	entry->ndeps = pending_ndeps;
+	entry->dep_relids = pending_relids;
+	entry->dep_counts = host_malloc(Max(pending_ndeps, 1) * sizeof(uint64));
+	pending_relids = NULL;
+	pending_ndeps = 0;
+	entry->result = copy_result(result);
+	if (!entry->dep_counts || !entry->result)
+	{
+		entry_free(entry);
+		return;
+	}
+	for (i = 0; i < entry->ndeps; i++)
+		entry->dep_counts[i] = pg_relmod_count(entry->dep_relids[i]);
+
+	entry->bytes = sizeof(CacheEntry) + sizeof(size_t) + len + 1 +
+		entry->ndeps * (sizeof(Oid) + sizeof(uint64)) +
+		result_bytes(entry->result);
+
+	if (cache_entries >= cache_nbuckets)
+		buckets_grow();
+
+	/* Too big to ever fit, or no buckets could be allocated */
+	if (entry->bytes > cache_max_bytes || cache_nbuckets == 0)
+	{
+		entry_free(entry);
+		return;
+	}
+
+	evict_to(cache_max_bytes - entry->bytes);
+
+	entry->hash_next = cache_buckets[entry->hash % cache_nbuckets];
+	cache_buckets[entry->hash % cache_nbuckets] = entry;
+	lru_push_front(entry);
+	cache_bytes += entry->bytes;
+	cache_entries++;
+}
+
+/*
+ * pg_embedded_set_result_cache_size
+ *
+ * Set the memory limit of the result cache; 0 disables and empties it.
+ */
+void
+pg_embedded_set_result_cache_size(size_t max_bytes)
+{
+	cache_max_bytes = max_bytes;
+	if (max_bytes == 0)
+		pg_embedded_result_cache_clear();
+	else
+		evict_to(max_bytes);
+}
+
+/*
+ * pg_embedded_result_cache_clear
+ *
+ * Drop every cached result.
+ */
+void
+pg_embedded_result_cache_clear(void)
+{
+	while (lru_tail != NULL)
+		entry_remove(lru_tail);
+	host_free(cache_buckets);
+	cache_buckets = NULL;
+	cache_nbuckets = 0;
+}
+
+/*
+ * pg_embedded_result_cache_stats
+ *
+ * Report the cache counters and current size.
+ */
+void
+pg_embedded_result_cache_stats(pg_result_cache_stats *stats)
+{
+	if (!stats)
+		return;
+
+	*stats = cache_stats;
+	stats->entries = cache_entries;
+	stats->bytes = cache_bytes;
+	stats->max_bytes = cache_max_bytes;
+}
@@ -0,0 +1,509 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_unlogged.c
+ *	  Unlogged-by-default tables for the PostgreSQL Embedded API
+ *
+ * Data that can be rebuilt, such as a cache, doesn't need to survive a
+ * crash, so writing WAL for it is wasted work.  With
+ * pg_embedded_config.unlogged_tables, or per schema with
+ * pg_embedded_set_schema_unlogged(), a ProcessUtility hook turns CREATE
+ * TABLE and CREATE TABLE AS / SELECT INTO into their UNLOGGED forms.  The
+ * indexes, TOAST tables and identity sequences of an unlogged table are
+ * unlogged as well.  Temporary and partitioned tables are left alone;
+ * partitioned tables can't be unlogged, but their partitions can.
+ *
+ * pg_embedded_set_logged() makes such tables permanent once their contents
+ * need to persist.
+ *
+ * Crash recovery resets every unlogged table to empty.  Before startup the
+ * control file tells whether the previous run shut down cleanly; if not,
+ * the unlogged tables that were emptied are listed for the host.
+ *
+ * Portions Copyright (c) 1996-2025, PostgreSQL Global Development Group
+ *
+ * src/backend/embedded/pg_unlogged.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgembedded.h"
+#include "pgembedded_internal.h"
+
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "access/xact.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_control.h"
+#include "common/controldata_utils.h"
+#include "executor/spi.h"
+#include "miscadmin.h"
+#include "nodes/parsenodes.h"
+#include "tcop/utility.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+
+/* Error message buffer (defined in pgembedded.c) */
+extern char pg_error_msg[1024];
+
+typedef struct SchemaSetting
+{
+	char		name[NAMEDATALEN];
+	bool		unlogged;
+} SchemaSetting;
+
+static bool unlogged_default = false;
+
+/* Per-schema overrides; malloc'd, they outlive pg_embedded_shutdown() */
+static SchemaSetting *schema_settings = NULL;
+static int	nschema_settings = 0;
+
+/* What the last pg_embedded_init found */
+static bool last_run_crashed = false;
+static char **reset_tables = NULL;
+static int	nreset_tables = 0;
+
+static ProcessUtility_hook_type prev_ProcessUtility = NULL;
+
+static void unlogged_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
+									bool readOnlyTree,
+									ProcessUtilityContext context,
+									ParamListInfo params,
+									QueryEnvironment *queryEnv,
+									DestReceiver *dest, QueryCompletion *qc);
+
+/*
+ * unlogged_init
+ *
+ * Called from pg_embedded_init() with the config setting.  The hook lives
+ * in static memory and is only installed once per process.
+ */
+void
+unlogged_init(bool unlogged)
+{
+	static bool hook_installed = false;
+
+	if (!hook_installed)
+	{
+		prev_ProcessUtility = ProcessUtility_hook;
+		ProcessUtility_hook = unlogged_ProcessUtility;
+		hook_installed = true;
+	}
+
+	unlogged_default = unlogged;
+}
+
+/*
+ * pg_embedded_set_schema_unlogged
+ */
+int
+pg_embedded_set_schema_unlogged(const char *schema, bool unlogged)
+{
+	int			i;
+
+	if (!schema || !*schema || strlen(schema) >= NAMEDATALEN)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Invalid schema name");
+		return -1;
+	}
+
+	for (i = 0; i < nschema_settings; i++)
+	{
+		if (strcmp(schema_settings[i].name, schema) == 0)
+		{
+			schema_settings[i].unlogged = unlogged;
+			return 0;
+		}
+	}
+
+	schema_settings = host_realloc(schema_settings,
+								   (nschema_settings + 1) * sizeof(SchemaSetting));
+	if (!schema_settings)
+	{
+		nschema_settings = 0;
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+		return -1;
+	}
+	strlcpy(schema_settings[nschema_settings].name, schema, NAMEDATALEN);
+	schema_settings[nschema_settings].unlogged = unlogged;
+	nschema_settings++;
+
+	return 0;
+}
+
+/* Should a table created in this schema be unlogged? */
+static bool
+schema_is_unlogged(Oid nspid)
+{
+	char	   *nspname = get_namespace_name(nspid);
+	int			i;
+
+	if (nspname)
+	{
+		for (i = 0; i < nschema_settings; i++)
+		{
+			if (strcmp(schema_settings[i].name, nspname) == 0)
+				return schema_settings[i].unlogged;
+		}
+	}
+	return unlogged_default;
+}
+
+/*
+ * make_unlogged
+ *
+ * Switch a permanent table about to be created to unlogged, if its schema
+ * says so.  The namespace lookup is the one DefineRelation() will do.
+ */
+static bool
+make_unlogged(RangeVar *relation)
+{
+	Oid			nspid;
+
+	if (relation->relpersistence != RELPERSISTENCE_PERMANENT)
+		return false;
+
+	/* pg_temp.foo is created temporary, and can't be unlogged */
+	nspid = RangeVarGetCreationNamespace(relation);
+	if (isAnyTempNamespace(nspid) || !schema_is_unlogged(nspid))
+		return false;
+
+	relation->relpersistence = RELPERSISTENCE_UNLOGGED;
+	return true;
+}
+
+static void
+unlogged_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
+						bool readOnlyTree, ProcessUtilityContext context,
+						ParamListInfo params, QueryEnvironment *queryEnv,
+						DestReceiver *dest, QueryCompletion *qc)
+{
+	Node	   *parsetree = pstmt->utilityStmt;
+
+	if (unlogged_default || nschema_settings > 0)
+	{
+		/* The tree may be cached; change a copy */
+		if (IsA(parsetree, CreateStmt) &&
+			((CreateStmt *) parsetree)->partspec == NULL)
+		{
+			if (readOnlyTree)
+			{
+				pstmt = copyObject(pstmt);
+				readOnlyTree = false;
+			}
+			make_unlogged(((CreateStmt *) pstmt->utilityStmt)->relation);
+		}
+		else if (IsA(parsetree, CreateTableAsStmt) &&
+				 ((CreateTableAsStmt *) parsetree)->objtype == OBJECT_TABLE)
+		{
+			if (readOnlyTree)
+			{
+				pstmt = copyObject(pstmt);
+				readOnlyTree = false;
+			}
+			make_unlogged(((CreateTableAsStmt *) pstmt->utilityStmt)->into->rel);
+		}
+	}
+
+	if (prev_ProcessUtility)
+		prev_ProcessUtility(pstmt, queryString, readOnlyTree, context, params,
+							queryEnv, dest, qc);
+	else
+		standard_ProcessUtility(pstmt, queryString, readOnlyTree, context,
+								params, queryEnv, dest, qc);
+}
+
+/*
+ * unlogged_tables
+ *
+ * Qualified names of the unlogged tables, in schema if it is valid, else
+ * in all schemas.  Called in a transaction; the list is palloc'd.
+ */
+static List *
+unlogged_tables(Oid nspid)
+{
+	Relation	classRel;
+	TableScanDesc scan;
+	HeapTuple	tuple;
+	List	   *tables = NIL;
+
+	classRel = table_open(RelationRelationId, AccessShareLock);
+	scan = table_beginscan_catalog(classRel, 0, NULL);
+	while ((tuple = heap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
+
+		if (classForm->relkind != RELKIND_RELATION ||
+			classForm->relpersistence != RELPERSISTENCE_UNLOGGED)
+			continue;
+		if (OidIsValid(nspid) && classForm->relnamespace != nspid)
+			continue;
+
+		tables = lappend(tables,
+						 quote_qualified_identifier(get_namespace_name(classForm->relnamespace),
+													NameStr(classForm->relname)));
+	}
+	table_endscan(scan);
+	table_close(classRel, AccessShareLock);
+
+	return tables;
+}
+
+/*
+ * set_logged
+ *
+ * ALTER TABLE ... SET LOGGED in a subtransaction.  Returns false, with the
+ * error in pg_error_msg, if it failed.
+ */
+static bool
+set_logged(const char *table)
+{
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	char	   *sql = psprintf("ALTER TABLE %s SET LOGGED", table);
+	bool		ok = true;
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_TRY();
+	{
+		if (SPI_execute(sql, false, 0) < 0)
+			elog(ERROR, "SPI_execute failed for \"%s\"", sql);
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(oldcxt);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcxt);
+		CurrentResourceOwner = oldowner;
+
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "%s: %s", table,
+				 edata->message);
+		FreeErrorData(edata);
+		ok = false;
+	}
+	PG_END_TRY();
+
+	pfree(sql);
+	return ok;
+}
+
+/*
+ * pg_embedded_set_logged
+ *
+ * A permanent table may not reference an unlogged one, so a table whose
+ * foreign keys point at tables not converted yet fails; those are retried
+ * until a round converts nothing more.
+ */
+int64_t
+pg_embedded_set_logged(const char *schema)
+{
+	volatile int64_t converted = 0;
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (IsTransactionState())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Cannot change table persistence inside a transaction");
+		return -1;
+	}
+
+	PG_TRY();
+	{
+		List	   *tables;
+		Oid			nspid = InvalidOid;
+
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+
+		if (schema)
+			nspid = get_namespace_oid(schema, false);
+		tables = unlogged_tables(nspid);
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "SPI_connect failed");
+
+		while (tables != NIL)
+		{
+			List	   *failed = NIL;
+			ListCell   *lc;
+
+			foreach(lc, tables)
+			{
+				char	   *table = lfirst(lc);
+
+				if (set_logged(table))
+					converted++;
+				else
+					failed = lappend(failed, table);
+			}
+
+			if (list_length(failed) == list_length(tables))
+				ereport(ERROR, (errmsg("%s", pg_error_msg)));
+
+			list_free(tables);
+			tables = failed;
+		}
+
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Set logged failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+		return -1;
+	}
+	PG_END_TRY();
+
+	return converted;
+}
+
+/*
+ * unlogged_check_crash
+ *
+ * Called from pg_embedded_init() once the data directory is known, before
+ * recovery can change the control file.
+ */
+void
+unlogged_check_crash(void)
+{
+	ControlFileData *control;
+	bool		crc_ok;
+	int			i;
+
+	for (i = 0; i < nreset_tables; i++)
+		host_free(reset_tables[i]);
+	host_free(reset_tables);
+	reset_tables = NULL;
+	nreset_tables = 0;
+
+	control = get_controlfile(DataDir, &crc_ok);
+	last_run_crashed = crc_ok &&
+		control->state != DB_SHUTDOWNED &&
+		control->state != DB_SHUTDOWNED_IN_RECOVERY;
+	pfree(control);
+}
+
+/*
+ * unlogged_collect_reset
+ *
+ * Called at the end of pg_embedded_init(): after a crash, every unlogged
+ * table has just been reset to empty by recovery.
+ */
+void
+unlogged_collect_reset(void)
+{
+	List	   *tables;
+	ListCell   *lc;
+
+	if (!last_run_crashed)
+		return;
+
+	StartTransactionCommand();
+	tables = unlogged_tables(InvalidOid);
+
+	reset_tables = host_malloc(Max(list_length(tables), 1) * sizeof(char *));
+	if (reset_tables)
+	{
+		foreach(lc, tables)
+		{
+			char	   *name = host_strdup(lfirst(lc));
+
+			if (name)
+				reset_tables[nreset_tables++] = name;
+		}
+	}
+	CommitTransactionCommand();
+}
+
+/*
+ * pg_embedded_unlogged_reset
+ */
+int
+pg_embedded_unlogged_reset(pg_unlogged_reset *out)
+{
+	int			i;
+
+	if (!out)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "NULL argument");
+		return -1;
+	}
+	memset(out, 0, sizeof(pg_unlogged_reset));
+
+	if (!pg_embedded_is_initialized())
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	out->crashed = last_run_crashed;
+	if (nreset_tables == 0)
+		return 0;
+
+	out->tables = host_calloc(nreset_tables, sizeof(char *));
+	if (!out->tables)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+		return -1;
+	}
+	for (i = 0; i < nreset_tables; i++)
+	{
+		out->tables[i] = host_strdup(reset_tables[i]);
+		if (!out->tables[i])
+		{
+			pg_embedded_free_unlogged_reset(out);
+			snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
+			return -1;
+		}
+		out->ntables++;
+	}
+
+	return 0;
+}
+
+/* Free the table names of a pg_unlogged_reset */
+void
+pg_embedded_free_unlogged_reset(pg_unlogged_reset *reset)
+{
+	int			i;
+
+	if (!reset)
+		return;
+	for (i = 0; i < reset->ntables; i++)
+		host_free(reset->tables[i]);
+	host_free(reset->tables);
+	reset->tables = NULL;
+	reset->ntables = 0;
+}
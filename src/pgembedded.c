@@ -22,10 +22,17 @@
 #include <unistd.h>
 
 #include "pgembedded.h"
+#include "pgembedded_internal.h"
 #include "initdb_embedded.h"
+#include "pg_relmod.h"
 
+#include "access/htup_details.h"
 #include "access/xact.h"
 #include "access/xlog.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_sequence.h"
+#include "commands/sequence.h"
+#include "common/int.h"
 #include "executor/spi.h"
 #include "libpq/libpq.h"
 #include "libpq/pqsignal.h"
@@ -33,16 +40,17 @@
 #include "storage/ipc.h"
 #include "storage/proc.h"
 #include "tcop/tcopprot.h"
+#include "utils/fmgrprotos.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/portal.h"
+#include "utils/resowner.h"
 #include "utils/snapmgr.h"
+#include "utils/syscache.h"
 #include "utils/timestamp.h"
+#include "utils/varlena.h"
 #include "commands/async.h"
 
-// from fd.c
-#define  NUM_RESERVED_FDS 10
-
 /* Notification queue for embedded mode */
 
 /* Error message buffer shared across the API */
@@ -77,18 +85,93 @@ void execute_atexit(void) {
 /* Static state */
 static bool pg_initialized = false;
 static char original_cwd[MAXPGPATH] = {0};
+static int	exec_depth = 0;		/* nesting of pg_embedded_exec calls */
+static const char *reentry_forbidden_in = NULL;	/* see exec_forbid_reentry() */
 
 /* Pre-initialization config settings */
 static struct {
 	bool fsync;
 	bool synchronous_commit;
 	bool full_page_writes;
+	bool logical_decoding;
+	bool autoprewarm;
+	bool autoprewarm_upfront;
+	bool catcache_image;
+	size_t memory_budget;
+	pg_memory_profile memory_profile;
+	int max_locks_per_transaction;
+	pg_huge_pages huge_pages;
+	size_t huge_page_size;
+	pg_io_method io_method;
+	bool direct_io;
+	pg_compression wal_compression;
+	pg_compression toast_compression;
+	bool unlogged_tables;
+	int max_files;
+	int reserved_fds;
 } preinit_config = {
 	.fsync = true,                  /* default: enabled */
 	.synchronous_commit = true,     /* default: enabled */
-	.full_page_writes = true        /* default: enabled */
+	.full_page_writes = true,       /* default: enabled */
+	.logical_decoding = false,      /* default: wal_level = replica */
+	.autoprewarm = false,           /* default: no buffer list saved */
+	.autoprewarm_upfront = false,   /* default: load in pg_embedded_prewarm() */
+	.catcache_image = false,        /* default: caches start cold */
+	.memory_budget = 0,             /* default: server defaults */
+	.memory_profile = PG_MEMORY_PROFILE_OLTP,
+	.max_locks_per_transaction = 0, /* default: PostgreSQL's, or the profile's */
+	.huge_pages = PG_HUGE_PAGES_DEFAULT, /* default: postgresql.conf's */
+	.huge_page_size = 0,            /* default: the kernel's */
+	.io_method = PG_IO_METHOD_SYNC, /* default: no I/O workers to hand I/O to */
+	.direct_io = false,             /* default: through the page cache */
+	.wal_compression = PG_COMPRESSION_DEFAULT,  /* default: off */
+	.toast_compression = PG_COMPRESSION_DEFAULT, /* default: pglz */
+	.unlogged_tables = false,       /* default: tables are permanent */
+	.max_files = 0,                 /* default: 1000, or as many as the limit allows */
+	.reserved_fds = 0               /* default: 32 left to the host */
 };
 
+/*
+ * compression_name
+ *
+ * The GUC value for a compression method, or an error if this build
+ * doesn't have it.
+ */
+static const char *
+compression_name(pg_compression compression)
+{
+	switch (compression)
+	{
+		case PG_COMPRESSION_LZ4:
+#ifndef USE_LZ4
+			ereport(ERROR,
+					(errmsg("lz4 compression support was not built in"),
+					 errhint("Rebuild with make WITH_LZ4=1.")));
+#endif
+			return "lz4";
+		case PG_COMPRESSION_ZSTD:
+#ifndef USE_ZSTD
+			ereport(ERROR,
+					(errmsg("zstd compression support was not built in"),
+					 errhint("Rebuild with make WITH_ZSTD=1.")));
+#endif
+			return "zstd";
+		default:
+			return "pglz";
+	}
+}
+
+/*
+ * pg_embedded_is_initialized
+ *
+ * For the other API modules, which can't see pg_initialized
+ */
+bool
+pg_embedded_is_initialized(void)
+{
+	return pg_initialized;
+}
+
 
 /*
  * pg_embedded_initdb
@@ -159,6 +242,13 @@ pg_embedded_init_internal(const char *data_dir, const char *dbname,
 		/* Initialize memory context system - CRITICAL! */
 		MemoryContextInit();
 
+		/* Start counting relation changes before anything can happen */
+		pg_relmod_init();
+		live_query_reset();
+		named_query_reset();
+		plan_cache_reset();
+		unlogged_init(preinit_config.unlogged_tables);
+
 		/* Save current working directory so we can restore it on shutdown */
 		if (!getcwd(original_cwd, MAXPGPATH))
 		{
@@ -187,6 +277,9 @@ pg_embedded_init_internal(const char *data_dir, const char *dbname,
 		pqsignal(SIGUSR1, SIG_IGN);  /* ignore SIGUSR1 (used for checkpoints in multi-user mode) */
 		pqsignal(SIGUSR2, SIG_IGN);  /* ignore SIGUSR2 */
 
+		/* Timeouts, for pg_embedded_autovacuum()'s deadline */
+		maintenance_timeout_init();
+
 		/* Initialize configuration */
 		InitializeGUCOptions();
 
@@ -205,6 +298,77 @@ pg_embedded_init_internal(const char *data_dir, const char *dbname,
 		SetConfigOption("timezone_abbreviations", "Default",
 						PGC_POSTMASTER, PGC_S_ARGV);
 
+		if (preinit_config.logical_decoding)
+			SetConfigOption("wal_level", "logical",
+							PGC_POSTMASTER, PGC_S_ARGV);
+
+#ifdef PG_EMBEDDED_PRIVATE_SHMEM
+		/* Dynamic segments as files in pg_dynshmem, removed at next start */
+		SetConfigOption("dynamic_shared_memory_type", "mmap",
+						PGC_POSTMASTER, PGC_S_ARGV);
+#endif
+
+		/* Also sizes the fast-path lock slots, in InitializeFastPathLocks() */
+		if (preinit_config.memory_budget > 0)
+			memory_budget_apply(preinit_config.memory_budget,
+								preinit_config.memory_profile,
+								preinit_config.max_locks_per_transaction);
+		else if (preinit_config.max_locks_per_transaction > 0)
+		{
+			char		locks[16];
+
+			snprintf(locks, sizeof(locks), "%d",
+					 preinit_config.max_locks_per_transaction);
+			SetConfigOption("max_locks_per_transaction", locks,
+							PGC_POSTMASTER, PGC_S_ARGV);
+		}
+
+		/* Transparent huge pages are asked for once the segment exists */
+		if (preinit_config.huge_pages != PG_HUGE_PAGES_DEFAULT)
+			SetConfigOption("huge_pages",
+							preinit_config.huge_pages == PG_HUGE_PAGES_ON ? "on" :
+							preinit_config.huge_pages == PG_HUGE_PAGES_TRY ? "try" : "off",
+							PGC_POSTMASTER, PGC_S_ARGV);
+		shmem_thp_requested = preinit_config.huge_pages == PG_HUGE_PAGES_TRANSPARENT;
+		if (preinit_config.huge_page_size > 0)
+		{
+			char		size[32];
+
+			snprintf(size, sizeof(size), "%zukB",
+					 preinit_config.huge_page_size / 1024);
+			SetConfigOption("huge_page_size", size, PGC_POSTMASTER, PGC_S_ARGV);
+		}
+
+		if (preinit_config.io_method == PG_IO_METHOD_IO_URING)
+		{
+#ifdef USE_LIBURING
+			SetConfigOption("io_method", "io_uring", PGC_POSTMASTER, PGC_S_ARGV);
+#else
+			ereport(ERROR,
+					(errmsg("io_uring support was not built in"),
+					 errhint("Rebuild with make WITH_LIBURING=1.")));
+#endif
+		}
+		else
+			SetConfigOption("io_method", "sync", PGC_POSTMASTER, PGC_S_ARGV);
+
+		if (preinit_config.direct_io)
+			SetConfigOption("debug_io_direct", "data,wal",
+							PGC_POSTMASTER, PGC_S_ARGV);
+
+		if (preinit_config.wal_compression != PG_COMPRESSION_DEFAULT)
+			SetConfigOption("wal_compression",
+							compression_name(preinit_config.wal_compression),
+							PGC_POSTMASTER, PGC_S_ARGV);
+
+		if (preinit_config.toast_compression == PG_COMPRESSION_ZSTD)
+			ereport(ERROR,
+					(errmsg("TOAST compression supports pglz and lz4 only")));
+		if (preinit_config.toast_compression != PG_COMPRESSION_DEFAULT)
+			SetConfigOption("default_toast_compression",
+							compression_name(preinit_config.toast_compression),
+							PGC_POSTMASTER, PGC_S_ARGV);
+
 		/*
 		 * Enable system table modifications if requested (needed for initdb).
 		 * This must be set before SelectConfigFiles() is called.
@@ -230,6 +394,13 @@ pg_embedded_init_internal(const char *data_dir, const char *dbname,
 		/* Read control file */
 		LocalProcessControlFile(false);
 
+		/* Did the last run shut down cleanly, before recovery says it did? */
+		unlogged_check_crash();
+
+		/* Make the built-in CDC output plugin and trigger function loadable */
+		register_cdc_output_plugin();
+		register_host_trigger_library();
+
 		/* Load shared libraries */
 		process_shared_preload_libraries();
 
@@ -269,12 +440,14 @@ pg_embedded_init_internal(const char *data_dir, const char *dbname,
 		 */
 		CreateSharedMemoryAndSemaphores();
 
+		if (preinit_config.huge_pages == PG_HUGE_PAGES_TRANSPARENT)
+			shmem_advise_huge_pages();
+
 		/*
 		 * Estimate number of openable files.  This must happen after setting up
 		 * semaphores, because on some platforms semaphores count as open files.
 		 */
-		// set_max_safe_fds();
-		max_safe_fds = 1024 - NUM_RESERVED_FDS;
+		fd_budget_apply(preinit_config.max_files, preinit_config.reserved_fds);
 
 		/*
 		 * Remember stand-alone backend startup time,roughly at the same point
@@ -329,6 +502,17 @@ pg_embedded_init_internal(const char *data_dir, const char *dbname,
 		*/
 
 		pg_initialized = true;
+
+		/* Read back the buffer list saved by the last shutdown */
+		if (preinit_config.autoprewarm)
+			autoprewarm_load(preinit_config.autoprewarm_upfront);
+
+		/* Look up the catalog entries the last run had cached */
+		if (preinit_config.catcache_image)
+			catcache_image_load();
+
+		/* Name the unlogged tables recovery has just emptied */
+		unlogged_collect_reset();
 	}
 	PG_CATCH();
 	{
@@ -372,13 +556,13 @@ pg_embedded_init_with_system_mods(const char *data_dir, const char *dbname, cons
 }
 
 /*
- * copy_tuptable
+ * pg_embedded_copy_tuptable
  *
  * Copy SPI tuple table results into a pg_result structure.
  * Returns 0 on success, -1 on failure.
  */
-static int
-copy_tuptable(pg_result *result, SPITupleTable *tuptable)
+int
+pg_embedded_copy_tuptable(pg_result *result, SPITupleTable *tuptable)
 {
 	TupleDesc	tupdesc = tuptable->tupdesc;
 	uint64_t	row;
@@ -386,7 +570,7 @@ copy_tuptable(pg_result *result, SPITupleTable *tuptable)
 
 
 	/* Allocate column names array */
-	result->colnames = (char **) malloc(result->cols * sizeof(char *));
+	result->colnames = (char **) host_malloc(result->cols * sizeof(char *));
 	if (!result->colnames)
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
@@ -398,11 +582,11 @@ copy_tuptable(pg_result *result, SPITupleTable *tuptable)
 	{
 		Form_pg_attribute attr = TupleDescAttr(tupdesc, col);
 
-		result->colnames[col] = strdup(NameStr(attr->attname));
+		result->colnames[col] = host_strdup(NameStr(attr->attname));
 	}
 
 	/* Allocate result matrix */
-	result->values = (char ***) malloc(result->rows * sizeof(char **));
+	result->values = (char ***) host_malloc(result->rows * sizeof(char **));
 	if (!result->values)
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
@@ -414,7 +598,7 @@ copy_tuptable(pg_result *result, SPITupleTable *tuptable)
 	{
 		HeapTuple	tuple = tuptable->vals[row];
 
-		result->values[row] = (char **) malloc(result->cols * sizeof(char *));
+		result->values[row] = (char **) host_malloc(result->cols * sizeof(char *));
 		if (!result->values[row])
 		{
 			snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
@@ -432,7 +616,7 @@ copy_tuptable(pg_result *result, SPITupleTable *tuptable)
 				result->values[row][col] = NULL;
 			else
 			{
-				result->values[row][col] = strdup(str);
+				result->values[row][col] = host_strdup(str);
 				pfree(str);
 			}
 		}
@@ -441,6 +625,61 @@ copy_tuptable(pg_result *result, SPITupleTable *tuptable)
 	return 0;
 }
 
+/*
+ * exec_call_begin / exec_call_end
+ *
+ * Bracket an API call that executes SQL.  Whatever the call allocates
+ * outside the transaction's contexts goes into MessageContext, which is
+ * reset, and the per-call memory limit restarted, only around the
+ * outermost call: host callbacks (triggers, live queries) may call back
+ * in.  exec_call_begin() returns the nesting depth, 1 when outermost.
+ */
+int
+exec_call_begin(void)
+{
+	if (exec_depth++ == 0)
+	{
+		MemoryContextReset(MessageContext);
+		mmgr_call_begin();
+	}
+	return exec_depth;
+}
+
+void
+exec_call_end(void)
+{
+	if (--exec_depth == 0)
+	{
+		MemoryContextReset(MessageContext);
+		mmgr_call_end();
+	}
+}
+
+/*
+ * exec_forbid_reentry / exec_reentry_forbidden
+ *
+ * Host callbacks run where SQL must not, such as CDC callbacks under
+ * logical decoding's historic snapshots, are bracketed with
+ * exec_forbid_reentry("<where>") and exec_forbid_reentry(NULL).  API
+ * calls that would run SQL in, or end, the current transaction check
+ * exec_reentry_forbidden() first, which sets the error message.
+ */
+void
+exec_forbid_reentry(const char *where)
+{
+	reentry_forbidden_in = where;
+}
+
+bool
+exec_reentry_forbidden(void)
+{
+	if (reentry_forbidden_in == NULL)
+		return false;
+	snprintf(pg_error_msg, sizeof(pg_error_msg),
+			 "Cannot be called from %s", reentry_forbidden_in);
+	return true;
+}
+
 /*
  * pg_embedded_exec
  *
@@ -450,10 +689,17 @@ pg_result *
 pg_embedded_exec(const char *query)
 {
 	pg_result  *result;
+	MemoryContext oldcxt;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	bool		in_tx;
 	int			ret;
+	int			depth;
 	volatile bool	implicit_tx = false;
+	volatile bool	subxact = false;
 	volatile bool	spi_connected = false;
 	volatile bool	snapshot_pushed = false;
+	volatile bool	cacheable = false;
+	char	   *cache_key = NULL;
 	ErrorData  *edata;
 
 
@@ -463,14 +709,25 @@ pg_embedded_exec(const char *query)
 		return NULL;
 	}
 
+	if (exec_reentry_forbidden())
+		return NULL;
+
 	if (!query)
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "NULL query");
 		return NULL;
 	}
 
+	/* Served from the result cache without touching the executor */
+	if (result_cache_enabled())
+	{
+		result = result_cache_lookup(query, &cache_key);
+		if (result)
+			return result;
+	}
+
 	/* Allocate result structure */
-	result = (pg_result *) malloc(sizeof(pg_result));
+	result = (pg_result *) host_malloc(sizeof(pg_result));
 	if (!result)
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "Out of memory");
@@ -479,6 +736,10 @@ pg_embedded_exec(const char *query)
 
 	memset(result, 0, sizeof(pg_result));
 
+	depth = exec_call_begin();
+	in_tx = IsTransactionState();
+	oldcxt = MemoryContextSwitchTo(MessageContext);
+
 	PG_TRY();
 	{
 
@@ -493,8 +754,16 @@ pg_embedded_exec(const char *query)
 			StartTransactionCommand();
 			implicit_tx = true;
 		}
-		else
+		else if (depth > 1)
 		{
+			/*
+			 * Called back from inside another call's statement, whose
+			 * executor frames are still on the stack: an error here may
+			 * only roll back this call's own work.
+			 */
+			BeginInternalSubTransaction(NULL);
+			MemoryContextSwitchTo(MessageContext);
+			subxact = true;
 		}
 
 		/*
@@ -512,8 +781,18 @@ pg_embedded_exec(const char *query)
 		else
 		{
 			spi_connected = true;
-			ret = SPI_execute(query, false, 0);	/* false = read-write, 0 = no
-								 * row limit */
+			if (cache_key != NULL)
+			{
+				bool		can_cache;
+
+				ret = result_cache_execute(query, &can_cache);
+				cacheable = can_cache;
+			}
+			else if (plan_cache_enabled())
+				ret = plan_cache_execute(query);
+			else
+				ret = SPI_execute(query, false, 0);	/* false = read-write, 0 = no
+									 * row limit */
 
 			result->status = ret;
 			result->rows = SPI_processed;
@@ -527,7 +806,7 @@ pg_embedded_exec(const char *query)
 				/*
 				 * Copy data for queries with results (SELECT or RETURNING)
 				 */
-				if (copy_tuptable(result, SPI_tuptable) != 0)
+				if (pg_embedded_copy_tuptable(result, SPI_tuptable) != 0)
 				{
 					pg_embedded_free_result(result);
 					result = NULL;
@@ -540,6 +819,17 @@ pg_embedded_exec(const char *query)
 		snapshot_pushed = false;
 		PopActiveSnapshot();
 
+		if (subxact)
+		{
+			if (result != NULL && result->status >= 0)
+				ReleaseCurrentSubTransaction();
+			else
+				RollbackAndReleaseCurrentSubTransaction();
+			subxact = false;
+			MemoryContextSwitchTo(MessageContext);
+			CurrentResourceOwner = oldowner;
+		}
+
 		if (implicit_tx) {
 			if (result != NULL && result->status >= 0) {
 				CommitTransactionCommand();
@@ -552,20 +842,49 @@ pg_embedded_exec(const char *query)
 	{
 		fprintf(stderr, "[WARN] In PG_CATCH\n");
 
+		MemoryContextSwitchTo(MessageContext);
 		edata = CopyErrorData();
 
 		snprintf(pg_error_msg, sizeof(pg_error_msg),
 				 "Query failed: %s", edata->message);
 
 		FlushErrorState();
-		if (snapshot_pushed) PopActiveSnapshot();
-		if (spi_connected) SPI_finish();
-		AbortCurrentTransaction();
+		if (subxact)
+		{
+			/* Also ends this call's SPI connection and snapshot */
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(MessageContext);
+			CurrentResourceOwner = oldowner;
+		}
+		else
+		{
+			if (snapshot_pushed) PopActiveSnapshot();
+			if (spi_connected) SPI_finish();
+			AbortCurrentTransaction();
+		}
 
 		result->status = -1;
 	}
 	PG_END_TRY();
 
+	/*
+	 * An error inside a pg_embedded_begin() transaction aborted it, and
+	 * oldcxt, one of its contexts, with it.
+	 */
+	if (!in_tx || IsTransactionState())
+		MemoryContextSwitchTo(oldcxt);
+	else
+		MemoryContextSwitchTo(TopMemoryContext);
+	exec_call_end();
+
+	if (cache_key != NULL)
+	{
+		if (cacheable && result != NULL && result->status >= 0)
+			result_cache_store(cache_key, result);
+		else
+			host_free(cache_key);
+	}
+
 	return result;
 }
 
@@ -589,9 +908,9 @@ pg_embedded_free_result(pg_result *result)
 		for (col = 0; col < result->cols; col++)
 		{
 			if (result->colnames[col])
-				free(result->colnames[col]);
+				host_free(result->colnames[col]);
 		}
-		free(result->colnames);
+		host_free(result->colnames);
 	}
 
 	/* Free data values */
@@ -604,15 +923,15 @@ pg_embedded_free_result(pg_result *result)
 				for (col = 0; col < result->cols; col++)
 				{
 					if (result->values[row][col])
-						free(result->values[row][col]);
+						host_free(result->values[row][col]);
 				}
-				free(result->values[row]);
+				host_free(result->values[row]);
 			}
 		}
-		free(result->values);
+		host_free(result->values);
 	}
 
-	free(result);
+	host_free(result);
 }
 
 /*
@@ -670,6 +989,9 @@ pg_embedded_commit(void)
 		return -1;
 	}
 
+	if (exec_reentry_forbidden())
+		return -1;
+
 	if (!IsTransactionState())
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not in transaction");
@@ -711,6 +1033,9 @@ pg_embedded_rollback(void)
 		return -1;
 	}
 
+	if (exec_reentry_forbidden())
+		return -1;
+
 	if (!IsTransactionState())
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not in transaction");
@@ -745,6 +1070,22 @@ pg_embedded_set_config(const pg_embedded_config *config)
 		preinit_config.fsync = config->fsync;
 		preinit_config.synchronous_commit = config->synchronous_commit;
 		preinit_config.full_page_writes = config->full_page_writes;
+		preinit_config.logical_decoding = config->logical_decoding;
+		preinit_config.autoprewarm = config->autoprewarm;
+		preinit_config.autoprewarm_upfront = config->autoprewarm_upfront;
+		preinit_config.catcache_image = config->catcache_image;
+		preinit_config.memory_budget = config->memory_budget;
+		preinit_config.memory_profile = config->memory_profile;
+		preinit_config.max_locks_per_transaction = config->max_locks_per_transaction;
+		preinit_config.huge_pages = config->huge_pages;
+		preinit_config.huge_page_size = config->huge_page_size;
+		preinit_config.io_method = config->io_method;
+		preinit_config.direct_io = config->direct_io;
+		preinit_config.wal_compression = config->wal_compression;
+		preinit_config.toast_compression = config->toast_compression;
+		preinit_config.unlogged_tables = config->unlogged_tables;
+		preinit_config.max_files = config->max_files;
+		preinit_config.reserved_fds = config->reserved_fds;
 	}
 }
 
@@ -778,6 +1119,9 @@ pg_embedded_listen(const char *channel)
 		return -1;
 	}
 
+	if (exec_reentry_forbidden())
+		return -1;
+
 	if (!channel || channel[0] == '\0')
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "Channel name required");
@@ -834,6 +1178,9 @@ pg_embedded_unlisten(const char *channel)
 		return -1;
 	}
 
+	if (exec_reentry_forbidden())
+		return -1;
+
 	PG_TRY();
 	{
 		bool implicit_tx = false;
@@ -890,6 +1237,9 @@ pg_embedded_notify(const char *channel, const char *payload)
 		return -1;
 	}
 
+	if (exec_reentry_forbidden())
+		return -1;
+
 	if (!channel || channel[0] == '\0')
 	{
 		snprintf(pg_error_msg, sizeof(pg_error_msg), "Channel name required");
@@ -930,6 +1280,98 @@ pg_embedded_notify(const char *channel, const char *payload)
 	return 0;
 }
 
+/*
+ * pg_embedded_reserve_ids
+ *
+ * Advance a sequence by n values at once: one nextval() to take the first
+ * value (with its locking, permission checks and WAL), then one setval()
+ * to the last value of the block.
+ */
+int
+pg_embedded_reserve_ids(const char *sequence, int64_t n, int64_t *first)
+{
+	if (!pg_initialized)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg), "Not initialized");
+		return -1;
+	}
+
+	if (exec_reentry_forbidden())
+		return -1;
+
+	if (!sequence || sequence[0] == '\0' || n < 1 || !first)
+	{
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Sequence name, a count >= 1 and an output pointer are required");
+		return -1;
+	}
+
+	PG_TRY();
+	{
+		bool		implicit_tx = false;
+		Oid			relid;
+		HeapTuple	pgstuple;
+		Form_pg_sequence seqform;
+		int64		start;
+		int64		span;
+		int64		last;
+		bool		in_bounds;
+
+		if (!IsTransactionState())
+		{
+			StartTransactionCommand();
+			implicit_tx = true;
+		}
+
+		relid = RangeVarGetRelid(makeRangeVarFromNameList(stringToQualifiedNameList(sequence, NULL)),
+								 NoLock, false);
+
+		start = nextval_internal(relid, true);
+
+		pgstuple = SearchSysCache1(SEQRELID, ObjectIdGetDatum(relid));
+		if (!HeapTupleIsValid(pgstuple))
+			elog(ERROR, "cache lookup failed for sequence %u", relid);
+		seqform = (Form_pg_sequence) GETSTRUCT(pgstuple);
+
+		in_bounds = !pg_mul_s64_overflow(n - 1, seqform->seqincrement, &span) &&
+			!pg_add_s64_overflow(start, span, &last) &&
+			last <= seqform->seqmax && last >= seqform->seqmin;
+		ReleaseSysCache(pgstuple);
+
+		if (!in_bounds)
+			ereport(ERROR,
+					(errcode(ERRCODE_SEQUENCE_GENERATOR_LIMIT_EXCEEDED),
+					 errmsg("cannot reserve %lld values from sequence \"%s\" starting at %lld",
+							(long long) n, sequence, (long long) start)));
+
+		if (n > 1)
+			DirectFunctionCall3(setval3_oid, ObjectIdGetDatum(relid),
+								Int64GetDatum(last), BoolGetDatum(true));
+
+		if (implicit_tx)
+		{
+			CommitTransactionCommand();
+		}
+
+		*first = start;
+	}
+	PG_CATCH();
+	{
+		ErrorData *edata;
+
+		edata = CopyErrorData();
+		snprintf(pg_error_msg, sizeof(pg_error_msg),
+				 "Reserving IDs failed: %s", edata->message);
+		FlushErrorState();
+		FreeErrorData(edata);
+		AbortCurrentTransaction();
+		return -1;
+	}
+	PG_END_TRY();
+
+	return 0;
+}
+
 /*
  * pg_embedded_shutdown
  *
@@ -943,6 +1385,13 @@ pg_embedded_shutdown(void)
 
 	PG_TRY();
 	{
+		/* Save the buffer list while the buffers are still there */
+		if (preinit_config.autoprewarm && autoprewarm_dump() < 0)
+			fprintf(stderr, "Warning: Failed to save the autoprewarm block list: %s\n",
+					pg_error_msg);
+		if (preinit_config.catcache_image && catcache_image_save() < 0)
+			fprintf(stderr, "Warning: Failed to save the catalog cache image\n");
+
 		/*
 		 * Use shmem_exit(0) instead of proc_exit(0).
 		 * This runs all the internal PostgreSQL cleanup hooks
@@ -16,6 +16,7 @@
 #ifndef PG_EMBEDDED_H
 #define PG_EMBEDDED_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "extensions.h"
@@ -88,6 +89,10 @@ int pg_embedded_set_extension_path(const char *path);
  *
  * query: SQL query string
  *
+ * May be called from a host trigger or live query callback; such a call
+ * runs in a subtransaction, so its failure doesn't abort the statement
+ * that fired the callback.
+ *
  * Returns result structure (must be freed with pg_embedded_free_result)
  * Returns NULL on error (check pg_embedded_error_message)
  */
@@ -96,6 +101,254 @@ pg_result *pg_embedded_exec(const char *query);
 /* Free result structure returned by pg_embedded_exec */
 void pg_embedded_free_result(pg_result *result);
 
+/*
+ * Result cache
+ *
+ * Opt-in cache of SELECT results inside pg_embedded_exec().  A repeated
+ * query is answered from memory, without parsing or executing it, until one
+ * of the relations it reads is modified (by a committed change or DDL).
+ * Only plain SELECTs without volatile or stable functions, row locks,
+ * sequences or catalog access are cached; inside a transaction that has written
+ * anything the cache is bypassed.
+ */
+
+typedef struct pg_result_cache_stats
+{
+	uint64_t	hits;			/* Queries answered from the cache */
+	uint64_t	misses;			/* Lookups that had to execute the query */
+	uint64_t	uncacheable;	/* Executed queries that could not be cached */
+	uint64_t	invalidations;	/* Entries dropped because a relation changed */
+	uint64_t	evictions;		/* Entries dropped to stay within max_bytes */
+	uint64_t	entries;		/* Current number of entries */
+	size_t		bytes;			/* Current memory use */
+	size_t		max_bytes;		/* Configured limit, 0 = disabled */
+} pg_result_cache_stats;
+
+/* Set the cache memory limit in bytes; 0 (the default) disables the cache */
+void pg_embedded_set_result_cache_size(size_t max_bytes);
+
+/* Drop all cached results */
+void pg_embedded_result_cache_clear(void);
+
+/* Get hit/miss statistics and the current size */
+void pg_embedded_result_cache_stats(pg_result_cache_stats *stats);
+
+/*
+ * Plan cache
+ *
+ * Opt-in plan reuse inside pg_embedded_exec() for SQL that embeds its
+ * values as literals.  The literals pg_stat_statements would normalize
+ * away become parameters, so queries differing only in those values share
+ * one plan and skip parsing and planning.  Strings, integers that fit
+ * int4, integers that fit int8 and other numbers make different shapes,
+ * since they can have different types.  Queries whose parameterized form
+ * doesn't work the same run as written.
+ */
+
+typedef struct pg_plan_cache_stats
+{
+	uint64_t	hits;			/* Executions that reused a cached plan */
+	uint64_t	misses;			/* Executions that had to prepare a new plan */
+	uint64_t	uncacheable;	/* Executions of shapes that run as written */
+	uint64_t	evictions;		/* Plans dropped to stay within max_entries */
+	uint64_t	entries;		/* Current number of query shapes */
+	int			max_entries;	/* Configured limit, 0 = disabled */
+} pg_plan_cache_stats;
+
+/* Set the maximum number of cached query shapes; 0 (the default) disables */
+void pg_embedded_set_plan_cache_size(int max_entries);
+
+/* Drop all cached plans */
+void pg_embedded_plan_cache_clear(void);
+
+/* Get hit/miss statistics and the current size */
+void pg_embedded_plan_cache_stats(pg_plan_cache_stats *stats);
+
+/*
+ * Memory limits
+ *
+ * Every block the engine's memory contexts take from the system is
+ * counted.  An allocation that would go over a limit fails with an
+ * "out of memory" error that aborts the current statement; the engine
+ * stays usable.
+ */
+
+/* Set the limits in bytes; 0 (the default) means no limit
+ *
+ * total: all memory contexts together
+ * per_call: growth during one pg_embedded_exec call
+ */
+void pg_embedded_set_memory_limits(size_t total, size_t per_call);
+
+/* Allocator for the engine's memory context blocks and for results
+ *
+ * Memory must be aligned for any type (16 bytes on x86_64).
+ */
+typedef struct pg_embedded_allocator
+{
+	void	   *(*malloc) (size_t size, void *arg);
+	void	   *(*realloc) (void *ptr, size_t size, void *arg);
+	void		(*free) (void *ptr, void *arg);
+	void	   *arg;			/* Passed to every callback */
+} pg_embedded_allocator;
+
+/* Route the engine's memory through the host's allocator
+ *
+ * Must be called before any other pg_embedded_* function; NULL goes back
+ * to the C library.
+ * Returns 0 on success, -1 on error
+ */
+int pg_embedded_set_allocator(const pg_embedded_allocator *allocator);
+
+/* One memory context, as MemoryContextStats() would print it */
+typedef struct pg_memory_context_stats
+{
+	char		name[64];
+	char		ident[64];		/* e.g. the relation of a relcache entry */
+	int			level;			/* 0 for TopMemoryContext */
+	int			parent;			/* Index of the parent, -1 for the root */
+	size_t		total_bytes;	/* Held in blocks */
+	size_t		used_bytes;
+	size_t		free_bytes;
+	size_t		blocks;
+	size_t		free_chunks;
+} pg_memory_context_stats;
+
+typedef struct pg_memory_stats
+{
+	size_t		total_bytes;	/* Sum of total_bytes over all contexts */
+	size_t		used_bytes;		/* Sum of used_bytes over all contexts */
+	size_t		system_bytes;	/* Taken from the system, as the limits count */
+	size_t		shared_memory_bytes;	/* Shared memory segment (shared buffers etc.) */
+	int			ncontexts;
+	pg_memory_context_stats *contexts;	/* Parents before children */
+} pg_memory_stats;
+
+/* Get the memory usage of every memory context
+ *
+ * Returns 0 on success, -1 on error
+ * Free with pg_embedded_free_memory_stats()
+ */
+int pg_embedded_memory_stats(pg_memory_stats *out);
+
+/* Free the context array of a pg_memory_stats */
+void pg_embedded_free_memory_stats(pg_memory_stats *stats);
+
+/* How hard pg_embedded_release_memory() should try */
+typedef enum pg_memory_pressure
+{
+	PG_MEMORY_PRESSURE_LOW,		/* Drop cached query results */
+	PG_MEMORY_PRESSURE_MEDIUM,	/* Also cached plans and unused catalog cache entries */
+	PG_MEMORY_PRESSURE_HIGH		/* Also named and live query plans */
+} pg_memory_pressure;
+
+/* Shrink the engine's caches when the host is short of memory
+ *
+ * Everything released is rebuilt on demand, so later queries are slower
+ * until the caches are warm again.  Catalog cache entries are freed for
+ * reuse, but their memory mostly stays with the engine.
+ * Must be called outside a transaction.
+ * Returns the number of bytes given back to the allocator, or -1 on error
+ */
+int64_t pg_embedded_release_memory(pg_memory_pressure level);
+
+/* Huge pages for shared memory: the buffer pool, WAL buffers etc. */
+typedef enum pg_huge_pages
+{
+	PG_HUGE_PAGES_DEFAULT,		/* huge_pages from postgresql.conf, else try */
+	PG_HUGE_PAGES_TRY,			/* Reserved huge pages if there are enough, else normal pages */
+	PG_HUGE_PAGES_OFF,
+	PG_HUGE_PAGES_ON,			/* Reserved huge pages, or fail pg_embedded_init */
+	PG_HUGE_PAGES_TRANSPARENT	/* Normal pages, madvise()d for transparent huge pages;
+								 * with a PRIVATE_SHMEM=1 build as soon as they are
+								 * mapped, otherwise after the WAL buffers were
+								 * zeroed, leaving those to khugepaged */
+} pg_huge_pages;
+
+/* Memory the engine was sized for, see pg_embedded_config.memory_budget */
+typedef struct pg_memory_footprint
+{
+	size_t		budget;					/* memory_budget, 0 if not set */
+	size_t		shared_memory_bytes;	/* Whole shared memory segment */
+	size_t		shared_buffers_bytes;
+	size_t		wal_buffers_bytes;
+	size_t		work_mem_bytes;			/* Per sort or hash */
+	size_t		maintenance_work_mem_bytes;
+	size_t		temp_buffers_bytes;
+	int			max_backends;			/* PGPROC slots */
+	int			max_locks_per_transaction;
+	int			fast_path_lock_slots;	/* Relation locks per transaction taken without the shared lock table */
+	pg_huge_pages huge_pages;			/* ON (reserved pages), TRANSPARENT (advised) or OFF */
+	size_t		huge_page_bytes;		/* Shared memory backed by huge pages right now */
+} pg_memory_footprint;
+
+/* Report how the engine's memory is sized
+ *
+ * With a memory_budget, shared memory plus one work_mem and the temporary
+ * buffers stay within it; the rest is left to the catalog caches and
+ * query memory.  Use pg_embedded_set_memory_limits() to enforce it.
+ *
+ * The weak locks that queries and DML take on relations go to a
+ * per-backend fast-path array instead of the shared lock table while it
+ * has free slots; fast_path_lock_slots is max_locks_per_transaction
+ * rounded up to a power of two, at most 16384.  A query touching many
+ * partitions locks each of them plus its indexes, so set
+ * pg_embedded_config.max_locks_per_transaction above that count (see
+ * examples/bench_partitions.c).  The shared lock table grows with it; under
+ * a memory_budget, beyond the profile's own, out of shared_buffers.
+ * Returns 0 on success, -1 on error
+ */
+int pg_embedded_memory_footprint(pg_memory_footprint *out);
+
+/*
+ * Unlogged tables
+ *
+ * Tables holding data that can be rebuilt (caches, scratch data) can skip
+ * the WAL: with pg_embedded_config.unlogged_tables, or per schema, CREATE
+ * TABLE and CREATE TABLE AS create UNLOGGED tables without any change to
+ * the SQL.  Their indexes, TOAST data and identity sequences are unlogged
+ * too.  A crash, or any shutdown that isn't clean, empties every unlogged
+ * table at the next pg_embedded_init.
+ */
+
+/* Override pg_embedded_config.unlogged_tables for one schema
+ *
+ * Can be called before pg_embedded_init; the setting is kept across
+ * shutdown and init.
+ * Returns 0 on success, -1 on error
+ */
+int pg_embedded_set_schema_unlogged(const char *schema, bool unlogged);
+
+/* Make unlogged tables permanent
+ *
+ * schema: Only tables in this schema, or NULL for all of them
+ *
+ * Each table is rewritten into the WAL (ALTER TABLE ... SET LOGGED), and
+ * tables that others reference by foreign key go first.  Everything is
+ * converted in one transaction, or nothing is.
+ * Must be called outside a transaction.
+ * Returns the number of tables converted, or -1 on error
+ */
+int64_t pg_embedded_set_logged(const char *schema);
+
+/* What crash recovery did to unlogged tables at the last pg_embedded_init */
+typedef struct pg_unlogged_reset
+{
+	bool		crashed;		/* The run before didn't shut down cleanly */
+	int			ntables;
+	char	  **tables;			/* Qualified names of the tables emptied */
+} pg_unlogged_reset;
+
+/* Report the unlogged tables emptied by crash recovery
+ *
+ * Returns 0 on success, -1 on error
+ * Free with pg_embedded_free_unlogged_reset()
+ */
+int pg_embedded_unlogged_reset(pg_unlogged_reset *out);
+
+/* Free the table names of a pg_unlogged_reset */
+void pg_embedded_free_unlogged_reset(pg_unlogged_reset *reset);
+
 /*
  * Transaction control
  */
@@ -109,6 +362,92 @@ int pg_embedded_commit(void);
 /* Rollback current transaction - returns 0 on success, -1 on error */
 int pg_embedded_rollback(void);
 
+/*
+ * Background maintenance
+ *
+ * A standalone backend has no WAL writer, background writer or
+ * checkpointer.  Call pg_embedded_tick() from the host's idle time (or a
+ * timer on the thread that owns the database) to do their work in small
+ * slices instead of leaving it all to pg_embedded_shutdown().
+ */
+
+/* Flush WAL, write back dirty buffers for up to budget_us microseconds,
+ * and run a checkpoint if checkpoint_timeout or max_wal_size says one is
+ * due.
+ *
+ * Once a checkpoint is due, ticks write out the dirty buffers it would
+ * have to write, and it is started by the tick that finds them all
+ * written with budget to spare for as long as the previous checkpoint
+ * took.  A checkpoint is not interruptible: such a tick overruns its
+ * budget by the checkpoint's fsyncs and whatever was dirtied since the
+ * sweep.  Worst case, when a checkpoint has waited another
+ * checkpoint_timeout or for twice max_wal_size of WAL, it is run anyway
+ * and the tick overruns by a full checkpoint.
+ *
+ * Must be called outside a transaction.
+ * Returns 1 if a checkpoint was performed, 0 if not, -1 on error
+ */
+int pg_embedded_tick(uint64_t budget_us);
+
+/* VACUUM and/or ANALYZE the tables the autovacuum settings say are due
+ *
+ * Tables are picked from the statistics (dead tuples, inserts and changes
+ * since the last vacuum/analyze, transaction ID age) using the
+ * autovacuum_* thresholds and processed most urgent first, throttled by
+ * autovacuum_vacuum_cost_delay/limit.  budget_us is a hard limit: a VACUUM
+ * or ANALYZE still running at the deadline is cancelled, like one hitting
+ * statement_timeout, and its table left for the next call.  No table is
+ * started that its size and the throughput seen so far (a slow default
+ * before the first one) say won't fit, unless it needs protection against
+ * transaction ID wraparound, which needs a budget large enough for the
+ * whole table to ever complete.  A table that fails is skipped and logged.
+ * The deadline is a SIGALRM timer; timeout.c's handler replaces the host's
+ * only while this runs.
+ *
+ * Must be called outside a transaction.
+ * Returns the number of tables completed, or -1 on error
+ */
+int pg_embedded_autovacuum(uint64_t budget_us);
+
+/* Load blocks saved by the autoprewarm shutdown dump
+ *
+ * With pg_embedded_config.autoprewarm, the list of blocks in shared buffers
+ * is saved by pg_embedded_shutdown() and read back by pg_embedded_init(),
+ * sorted into sequential per-relation reads.  Unless autoprewarm_upfront
+ * loaded them during init, call this from idle time until it returns 0.
+ * Loading stops early once shared buffers are full.
+ *
+ * budget_us: time limit for this slice in microseconds (0 = no limit)
+ *
+ * Must be called outside a transaction.
+ * Returns the number of blocks still to load, or -1 on error
+ */
+int64_t pg_embedded_prewarm(uint64_t budget_us);
+
+/* Save the current buffer list now (e.g. periodically, to survive a crash)
+ * Returns the number of blocks saved, or -1 on error
+ */
+int64_t pg_embedded_prewarm_dump(void);
+
+/*
+ * Sequences
+ */
+
+/* Reserve a block of values from a sequence for host-side ID assignment
+ *
+ * sequence: Sequence name, optionally schema-qualified
+ * n: Number of values to reserve (>= 1)
+ * first: Receives the first reserved value
+ *
+ * The sequence is advanced by n in one step; the reserved values are
+ * first, first + increment, ..., first + (n - 1) * increment.  Like
+ * nextval(), the reservation is not undone by a rollback.  If the block
+ * would run past the sequence's bounds (reservations never cycle), an error
+ * is returned; the single value already taken at that point is lost.
+ * Returns 0 on success, -1 on error
+ */
+int pg_embedded_reserve_ids(const char *sequence, int64_t n, int64_t *first);
+
 /*
  * LISTEN/NOTIFY support
  */
@@ -175,16 +514,290 @@ pg_notification *pg_embedded_poll_notifications(void);
  */
 void pg_embedded_free_notification(pg_notification *notification);
 
+/*
+ * Change data capture
+ *
+ * Row-level changes are decoded from the WAL in-process (logical decoding
+ * with a built-in output plugin) and handed to a host callback as typed
+ * binary column values.  Requires pg_embedded_config.logical_decoding.
+ */
+
+typedef enum pg_cdc_op
+{
+	PG_CDC_BEGIN,
+	PG_CDC_INSERT,
+	PG_CDC_UPDATE,
+	PG_CDC_DELETE,
+	PG_CDC_TRUNCATE,
+	PG_CDC_COMMIT
+} pg_cdc_op;
+
+/* One column value of a decoded row */
+typedef struct pg_cdc_value
+{
+	bool isnull;
+	bool unchanged;       /* TOASTed value not modified by an UPDATE, not in the WAL */
+	uint64_t datum;       /* The Datum; the value itself for by-value types */
+	const void *data;     /* By-reference types: value bytes (varlena without header) */
+	size_t len;           /* Length of data */
+} pg_cdc_value;
+
+/* A decoded event, valid only for the duration of the callback */
+typedef struct pg_cdc_change
+{
+	pg_cdc_op op;
+	uint32_t xid;
+	uint64_t lsn;                 /* LSN of the change (commit LSN for COMMIT) */
+	uint64_t commit_lsn;          /* LSN of the transaction's commit record */
+	int64_t commit_time;          /* Commit timestamp (microseconds since 2000-01-01) */
+
+	/* Row and truncate events only */
+	uint32_t relid;
+	const char *nspname;
+	const char *relname;
+	int natts;
+	const uint32_t *atttypes;     /* Type OID per column (0 for dropped columns) */
+	const char *const *attnames;  /* Name per column (NULL for dropped columns) */
+	const pg_cdc_value *oldtuple; /* UPDATE/DELETE: old key or row (NULL if not logged) */
+	const pg_cdc_value *newtuple; /* INSERT/UPDATE: new row */
+} pg_cdc_change;
+
+/* Return 0 to continue, non-zero to stop after the current transaction.
+ * Stopping before a transaction's COMMIT event was delivered leaves that
+ * transaction unconfirmed; it is delivered again by the next poll.
+ * The callback runs in the middle of decoding and must not call back into
+ * the API to execute SQL or end a transaction; such calls fail.  Copy
+ * what it needs and act on it after pg_embedded_cdc_poll() returns. */
+typedef int (*pg_cdc_callback)(const pg_cdc_change *change, void *arg);
+
+/* Create a persistent CDC slot; changes committed afterwards are retained
+ * until consumed.  Must not be called inside a transaction.
+ * Returns 0 on success, -1 on error */
+int pg_embedded_cdc_create_slot(const char *slot_name);
+
+/* Drop a CDC slot - returns 0 on success, -1 on error */
+int pg_embedded_cdc_drop_slot(const char *slot_name);
+
+/* Deliver all changes committed since the slot's last checkpoint
+ *
+ * Events are delivered in commit order, BEGIN/row events/COMMIT per
+ * transaction.  Afterwards the slot's checkpoint is advanced past the
+ * delivered transactions and saved to disk, so consumption resumes there
+ * after a restart.  confirmed_lsn (optional) receives the new checkpoint.
+ *
+ * Must not be called inside a transaction.
+ * Returns the number of transactions delivered, or -1 on error
+ */
+int64_t pg_embedded_cdc_poll(const char *slot_name, pg_cdc_callback callback,
+                             void *arg, uint64_t *confirmed_lsn);
+
+/*
+ * Host triggers
+ *
+ * A host callback registered here can be attached to tables as a regular
+ * trigger through the built-in C trigger function pg_embedded_host_trigger.
+ * Create the function once per database:
+ *
+ *   CREATE FUNCTION pg_embedded_host_trigger() RETURNS trigger
+ *     LANGUAGE C AS 'pg_embedded_triggers', 'pg_embedded_host_trigger';
+ *
+ * and name the callback as the trigger's argument (or name the trigger
+ * after the callback and pass no argument):
+ *
+ *   CREATE TRIGGER items_changed AFTER INSERT OR UPDATE OR DELETE ON items
+ *     FOR EACH ROW EXECUTE FUNCTION pg_embedded_host_trigger('items_cb');
+ *
+ * For one call per statement instead of one per row, use a statement
+ * trigger with transition tables; all rows arrive in a single event:
+ *
+ *   CREATE TRIGGER items_ins AFTER INSERT ON items
+ *     REFERENCING NEW TABLE AS new_rows
+ *     FOR EACH STATEMENT EXECUTE FUNCTION pg_embedded_host_trigger('items_cb');
+ */
+
+typedef enum pg_trigger_op
+{
+	PG_TRIGGER_INSERT,
+	PG_TRIGGER_UPDATE,
+	PG_TRIGGER_DELETE,
+	PG_TRIGGER_TRUNCATE
+} pg_trigger_op;
+
+/* Trigger event, valid only for the duration of the callback
+ *
+ * Rows are stored row-major: column c of row r is values[r * natts + c].
+ * Values are raw Datums; for by-reference types they point into backend
+ * memory.  For UPDATE, old row r and new row r describe the same row.
+ */
+typedef struct pg_trigger_event
+{
+	pg_trigger_op op;
+	uint32_t relid;               /* OID of the table */
+	const char *trigger_name;
+	bool before;                  /* BEFORE trigger (the change hasn't happened yet) */
+	bool per_statement;           /* FOR EACH STATEMENT trigger */
+	int natts;
+	const uint32_t *atttypes;     /* Type OID per column (0 for dropped columns) */
+	uint64_t nrows;               /* 1 for row triggers, batch size for statement triggers */
+	const uint64_t *old_values;   /* NULL if there is no OLD row/table */
+	const bool *old_isnull;
+	const uint64_t *new_values;   /* NULL if there is no NEW row/table */
+	const bool *new_isnull;
+} pg_trigger_event;
+
+/* Return 0 on success; non-zero raises an error that aborts the statement */
+typedef int (*pg_trigger_callback)(const pg_trigger_event *event, void *arg);
+
+/* Register (or replace) the callback behind a host trigger name
+ *
+ * Can be called before or after pg_embedded_init; registrations persist
+ * across shutdown/reinit.
+ * Returns 0 on success, -1 on error
+ */
+int pg_embedded_register_trigger(const char *name, pg_trigger_callback callback,
+                                 void *arg);
+
+/*
+ * Live queries
+ *
+ * A live query is a SELECT whose result is pushed to a callback as a diff
+ * whenever it changes.  The relations it reads are taken from its plan and
+ * every committed change is counted per relation, so
+ * pg_embedded_live_refresh() only re-runs queries whose relations were
+ * modified since their last run; with nothing changed it costs nothing.
+ */
+
+/* Called with the rows that appeared and the rows that disappeared since the
+ * previous delivery (the first delivery has the whole result in "added").
+ * Rows are compared by their text values; duplicates count separately.
+ * Both results are freed after the callback returns.
+ */
+typedef void (*pg_live_query_callback)(int id, const pg_result *added,
+                                       const pg_result *removed, void *arg);
+
+/* Subscribe to a single read-only SELECT
+ *
+ * The query is planned once and its first result is delivered before this
+ * returns.
+ * Returns the subscription id (>= 0), or -1 on error
+ */
+int pg_embedded_live_query(const char *sql, pg_live_query_callback callback,
+                           void *arg);
+
+/* Drop a subscription - returns 0 on success, -1 if the id is unknown */
+int pg_embedded_live_query_cancel(int id);
+
+/* Re-run the subscriptions whose relations changed and deliver the diffs
+ *
+ * Must be called outside a transaction (uncommitted changes are not seen).
+ * Returns the number of queries re-run, or -1 on error
+ */
+int pg_embedded_live_refresh(void);
+
+/*
+ * Named queries
+ *
+ * Queries known at build time can be analyzed once by helpers/querygen,
+ * which writes a header with a pg_named_query table and an enum of ids.
+ * Executing them skips the analyzer; the plan is kept and only analyzed
+ * and planned again when a table, function or type it uses changes.
+ */
+
+/* One precompiled query, as generated by helpers/querygen */
+typedef struct pg_named_query
+{
+	const char *name;
+	const char *sql;					/* used if the trees can't be */
+	const char *query;					/* nodeToString() of the Query list */
+	const char *relations;				/* "oid:schema.name(columns) ..." at build time */
+	unsigned int catversion;			/* catalog version of the trees */
+	int			nparams;
+	const unsigned int *param_types;	/* type OID of each $n */
+} pg_named_query;
+
+/* Register a generated table; ids are indexes into it
+ *
+ * The table is not copied.  Returns 0 on success, -1 on error
+ */
+int pg_embedded_register_named_queries(const pg_named_query *queries, int count);
+
+/* Execute a registered query
+ *
+ * values: nparams parameter values in text form, NULL for SQL NULL
+ * Returns a result like pg_embedded_exec's, or NULL on error
+ */
+pg_result *pg_embedded_exec_named(int id, int nparams, const char *const *values);
+
+/* A query compiled by pg_embedded_compile_query, all malloc'd */
+typedef struct pg_compiled_query
+{
+	char	   *query;
+	char	   *relations;
+	unsigned int catversion;
+	int			nparams;
+	unsigned int *param_types;
+} pg_compiled_query;
+
+/* Analyze and rewrite a query against the current schema (for querygen)
+ *
+ * Parameter types are inferred from how $n are used.
+ * Returns 0 on success, -1 on error (the SQL error is in the message)
+ */
+int pg_embedded_compile_query(const char *sql, pg_compiled_query *out);
+
+/* Free the strings of a compiled query */
+void pg_embedded_free_compiled_query(pg_compiled_query *compiled);
+
 /*
  * Configuration
  */
 
+/* How data files are read and written */
+typedef enum pg_io_method
+{
+	PG_IO_METHOD_SYNC,			/* Plain reads and writes, with readahead advice */
+	PG_IO_METHOD_IO_URING		/* Asynchronous I/O; needs a WITH_LIBURING=1 build */
+} pg_io_method;
+
+/* Compression of full-page images in WAL, and of TOASTed values */
+typedef enum pg_compression
+{
+	PG_COMPRESSION_DEFAULT,		/* WAL: none; TOAST: pglz */
+	PG_COMPRESSION_PGLZ,
+	PG_COMPRESSION_LZ4,			/* Needs a WITH_LZ4=1 build */
+	PG_COMPRESSION_ZSTD			/* Needs a WITH_ZSTD=1 build; WAL only */
+} pg_compression;
+
+/* What memory_budget is mostly spent on */
+typedef enum pg_memory_profile
+{
+	PG_MEMORY_PROFILE_OLTP,		/* Mostly cache, small sorts and hashes */
+	PG_MEMORY_PROFILE_TINY,		/* Smallest footprint, for small devices */
+	PG_MEMORY_PROFILE_ANALYTICS	/* Large sorts, hashes and index builds */
+} pg_memory_profile;
+
 /* Performance configuration options */
 typedef struct pg_embedded_config
 {
 	bool fsync;                  /* Enable fsync (default: true) */
 	bool synchronous_commit;     /* Enable synchronous commit (default: true) */
 	bool full_page_writes;       /* Enable full page writes (default: true) */
+	bool logical_decoding;       /* wal_level = logical, needed for CDC (default: false) */
+	bool autoprewarm;            /* Save buffer list at shutdown, reload at init (default: false) */
+	bool autoprewarm_upfront;    /* Reload it fully inside pg_embedded_init (default: false) */
+	bool catcache_image;         /* Save catalog cache keys at shutdown, look them up at init (default: false) */
+	size_t memory_budget;        /* Size all engine memory for one backend in this many bytes (default: 0, server defaults) */
+	pg_memory_profile memory_profile; /* How memory_budget is split (default: PG_MEMORY_PROFILE_OLTP) */
+	int max_locks_per_transaction; /* Also the relation locks kept out of the shared lock table (default: 0, 64 or the profile's) */
+	pg_huge_pages huge_pages;    /* Huge pages for shared memory (default: PG_HUGE_PAGES_DEFAULT) */
+	size_t huge_page_size;       /* Size of reserved huge pages in bytes (default: 0, the kernel's) */
+	pg_io_method io_method;      /* I/O for data files (default: PG_IO_METHOD_SYNC) */
+	bool direct_io;              /* Bypass the kernel page cache for data and WAL files (default: false) */
+	pg_compression wal_compression;   /* Full-page images in WAL (default: none) */
+	pg_compression toast_compression; /* New TOASTed values, per column with ALTER TABLE (default: pglz) */
+	bool unlogged_tables;        /* New tables are created UNLOGGED, see pg_embedded_set_schema_unlogged (default: false) */
+	int max_files;               /* Files kept open at once, at most 65536 (default: 0, 1000 or RLIMIT_NOFILE less the ones below if lower); more than the soft RLIMIT_NOFILE allows raises it, for the whole process */
+	int reserved_fds;            /* Descriptors left to the host application (default: 0, 32) */
 } pg_embedded_config;
 
 /* Set performance configuration
@@ -206,6 +819,57 @@ typedef struct pg_embedded_config
  */
 void pg_embedded_set_config(const pg_embedded_config *config);
 
+/*
+ * I/O
+ *
+ * PostgreSQL's default io_method, worker, hands I/O to I/O worker
+ * processes, which don't exist in embedded mode; it would run everything
+ * synchronously.  Embedded mode defaults to sync instead.  With
+ * PG_IO_METHOD_IO_URING, sequential and bitmap heap scans, VACUUM and
+ * checkpoints keep several reads or writes in flight, up to
+ * effective_io_concurrency and io_combine_limit.
+ *
+ * direct_io skips the kernel's page cache (debug_io_direct = data,wal), so
+ * shared buffers are the only cache: size them with memory_budget.  It pairs
+ * with io_uring, which keeps the reads the kernel no longer reads ahead in
+ * flight.
+ */
+
+/*
+ * Files
+ *
+ * Every relation segment, WAL file and other file the engine uses is
+ * opened through a cache of virtual file descriptors, which keeps at most
+ * a budget of kernel descriptors open and closes the least recently used
+ * one when it needs another.  The budget is RLIMIT_NOFILE less the
+ * descriptors already open at init and reserved_fds, which are left for
+ * the host's own sockets and files, and at most max_files (1000 unless
+ * set, like max_files_per_process).  A max_files above that raises the
+ * soft limit up to the hard one; setrlimit() applies to the whole
+ * process, so the host's own files get the higher limit too.  With
+ * thousands of tables, set max_files above the number of relation files
+ * the workload touches so that they stay open.
+ */
+
+/* File descriptor budget and VFD cache counters, since init */
+typedef struct pg_file_stats
+{
+	int			fd_limit;		/* RLIMIT_NOFILE soft limit */
+	int			reserved_fds;	/* Left to the host */
+	int			max_safe_fds;	/* Budget of the VFD cache */
+	int			open_files;		/* Kernel descriptors it holds now */
+	int			vfds;			/* Virtual descriptors allocated */
+	uint64_t	hits;			/* Accesses to a file that was open */
+	uint64_t	misses;			/* Accesses that reopened a closed file */
+	uint64_t	evictions;		/* Files closed to stay within the budget */
+} pg_file_stats;
+
+/* Get file descriptor usage
+ *
+ * Returns 0 on success, -1 on error
+ */
+int pg_embedded_file_stats(pg_file_stats *out);
+
 /*
  * Error handling
  */
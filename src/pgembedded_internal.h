@@ -0,0 +1,87 @@
+/*
+ * pgembedded_internal.h
+ *   Internal interfaces shared between the embedded API modules
+ *
+ * Nothing in here is part of the public API; applications should only
+ * include pgembedded.h.
+ */
+
+#ifndef PGEMBEDDED_INTERNAL_H
+#define PGEMBEDDED_INTERNAL_H
+
+#include <stdbool.h>
+
+#include "pgembedded.h"
+
+struct SPITupleTable;
+
+/* pgembedded.c */
+extern bool pg_embedded_is_initialized(void);
+extern int	pg_embedded_copy_tuptable(pg_result *result,
+									  struct SPITupleTable *tuptable);
+extern int	exec_call_begin(void);
+extern void exec_call_end(void);
+extern void exec_forbid_reentry(const char *where);
+extern bool exec_reentry_forbidden(void);
+
+/* pg_cdc.c */
+#define PG_CDC_PLUGIN_NAME "pg_embedded_cdc"
+extern void register_cdc_output_plugin(void);
+
+/* pg_host_trigger.c */
+#define PG_HOST_TRIGGER_LIBRARY "pg_embedded_triggers"
+extern void register_host_trigger_library(void);
+
+/* pg_live_query.c */
+extern void live_query_reset(void);
+extern void live_query_release(void);
+
+/* pg_named_query.c */
+extern void named_query_reset(void);
+extern void named_query_release(void);
+
+/* pg_autoprewarm.c */
+extern int64_t autoprewarm_dump(void);
+extern void autoprewarm_load(bool upfront);
+
+/* pg_catcache_image.c */
+extern int	catcache_image_save(void);
+extern void catcache_image_load(void);
+
+/* pg_result_cache.c */
+extern bool result_cache_enabled(void);
+extern pg_result *result_cache_lookup(const char *query, char **key_out);
+extern int	result_cache_execute(const char *query, bool *cacheable);
+extern void result_cache_store(char *key, const pg_result *result);
+
+/* pg_memory.c */
+extern void *host_malloc(size_t size);
+extern void *host_calloc(size_t nmemb, size_t size);
+extern void *host_realloc(void *ptr, size_t size);
+extern char *host_strdup(const char *str);
+extern void host_free(void *ptr);
+extern void mmgr_call_begin(void);
+extern void mmgr_call_end(void);
+extern size_t mmgr_allocated_bytes(void);
+extern void memory_budget_apply(size_t budget, pg_memory_profile profile,
+								int max_locks);
+extern bool shmem_thp_requested;
+extern void shmem_advise_huge_pages(void);
+
+/* pg_maintenance.c */
+extern void maintenance_timeout_init(void);
+
+/* pg_files.c */
+extern void fd_budget_apply(int max_files, int reserved);
+
+/* pg_unlogged.c */
+extern void unlogged_init(bool unlogged);
+extern void unlogged_check_crash(void);
+extern void unlogged_collect_reset(void);
+
+/* pg_plan_cache.c */
+extern bool plan_cache_enabled(void);
+extern int	plan_cache_execute(const char *query);
+extern void plan_cache_reset(void);
+
+#endif /* PGEMBEDDED_INTERNAL_H */